@@ -0,0 +1,114 @@
+/*
+ * Clutter-GStreamer.
+ *
+ * GStreamer integration library for Clutter.
+ *
+ * bench-common.c - Helpers shared by the benchmarks
+ *
+ * Copyright (C) 2011 Intel Corporation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <sys/resource.h>
+
+#include <gst/gst.h>
+
+#include "bench-common.h"
+
+/* Returns the CPU time used by the process so far, in seconds */
+gdouble
+bench_get_cpu_time (void)
+{
+  struct rusage usage;
+
+  getrusage (RUSAGE_SELF, &usage);
+
+  return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+         (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+/* To sort arrays of doubles with qsort() or g_array_sort() */
+gint
+bench_compare_doubles (gconstpointer a,
+                       gconstpointer b)
+{
+  gdouble da = *(const gdouble *) a, db = *(const gdouble *) b;
+
+  return da < db ? -1 : da > db;
+}
+
+/* Returns the URI of @file, a URI already or a path relative to the
+ * current directory */
+gchar *
+bench_get_uri (const gchar *file)
+{
+  gchar *path, *cwd, *uri;
+
+  if (gst_uri_is_valid (file))
+    return g_strdup (file);
+
+  if (g_path_is_absolute (file))
+    path = g_strdup (file);
+  else
+    {
+      cwd = g_get_current_dir ();
+      path = g_build_filename (cwd, file, NULL);
+      g_free (cwd);
+    }
+
+  uri = g_filename_to_uri (path, NULL, NULL);
+  g_free (path);
+
+  return uri;
+}
+
+/* Appends ', "@name": @value' to the JSON object being built in @json,
+ * whatever the locale */
+void
+bench_append_double (GString     *json,
+                     const gchar *name,
+                     gdouble      value)
+{
+  gchar buffer[G_ASCII_DTOSTR_BUF_SIZE];
+
+  g_string_append_printf (json, ", \"%s\": %s", name,
+                          g_ascii_formatd (buffer, sizeof (buffer),
+                                           "%.3f", value));
+}
+
+/* Writes the results to @output, or to the standard output if %NULL */
+gboolean
+bench_write_json (GString     *json,
+                  const gchar *output)
+{
+  GError *error = NULL;
+
+  if (output == NULL)
+    {
+      g_print ("%s", json->str);
+      return TRUE;
+    }
+
+  if (!g_file_set_contents (output, json->str, json->len, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      g_error_free (error);
+      return FALSE;
+    }
+
+  return TRUE;
+}
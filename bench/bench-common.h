@@ -0,0 +1,48 @@
+/*
+ * Clutter-GStreamer.
+ *
+ * GStreamer integration library for Clutter.
+ *
+ * bench-common.h - Helpers shared by the benchmarks
+ *
+ * Copyright (C) 2011 Intel Corporation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __BENCH_COMMON_H__
+#define __BENCH_COMMON_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+gdouble  bench_get_cpu_time     (void);
+
+gint     bench_compare_doubles  (gconstpointer  a,
+                                 gconstpointer  b);
+
+gchar *  bench_get_uri          (const gchar   *file);
+
+void     bench_append_double    (GString       *json,
+                                 const gchar   *name,
+                                 gdouble        value);
+gboolean bench_write_json       (GString       *json,
+                                 const gchar   *output);
+
+G_END_DECLS
+
+#endif /* __BENCH_COMMON_H__ */
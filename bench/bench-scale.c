@@ -0,0 +1,469 @@
+/*
+ * Clutter-GStreamer.
+ *
+ * GStreamer integration library for Clutter.
+ *
+ * bench-scale.c - Play a growing number of ClutterGstVideoTexture at the
+ * same time and measure, for each step, the resident memory, the number of
+ * threads alive, the CPU usage, the latency of the dispatch of the main
+ * loop and the frame rate each texture gets.
+ *
+ * Copyright (C) 2011 Intel Corporation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <glib/gstdio.h>
+#include <clutter-gst/clutter-gst.h>
+
+#include "bench-common.h"
+
+/* the clip played when no URI is given, raw video so that no decoder
+ * gets in the way of the measures */
+#define CLIP_FRAMES 300
+#define CLIP_CAPS   "video/x-raw-yuv,format=(fourcc)I420,framerate=30/1"
+
+/* interval of the timeout measuring the dispatch latency, in ms */
+#define PROBE_INTERVAL 10
+
+#define STAGE_WIDTH  640
+#define STAGE_HEIGHT 480
+
+static gint     opt_max_textures = 64;
+static gint     opt_duration     = 5;
+static gint     opt_settle       = 2;
+static gint     opt_width        = 320;
+static gint     opt_height       = 240;
+static gchar   *opt_uri          = NULL;
+static gchar   *opt_output       = NULL;
+
+static GOptionEntry options[] =
+{
+  { "max-textures",
+    'n', 0,
+    G_OPTION_ARG_INT,
+    &opt_max_textures,
+    "Number of textures of the last step (default is 64)",
+    NULL
+  },
+  { "duration",
+    'd', 0,
+    G_OPTION_ARG_INT,
+    &opt_duration,
+    "Seconds measured at each step (default is 5)",
+    NULL
+  },
+  { "settle",
+    's', 0,
+    G_OPTION_ARG_INT,
+    &opt_settle,
+    "Seconds left to the new textures to start playing (default is 2)",
+    NULL
+  },
+  { "width",
+    'W', 0,
+    G_OPTION_ARG_INT,
+    &opt_width,
+    "Width of the generated clip (default is 320)",
+    NULL
+  },
+  { "height",
+    'H', 0,
+    G_OPTION_ARG_INT,
+    &opt_height,
+    "Height of the generated clip (default is 240)",
+    NULL
+  },
+  { "uri",
+    'u', 0,
+    G_OPTION_ARG_STRING,
+    &opt_uri,
+    "Play URI instead of a clip generated with videotestsrc",
+    "URI"
+  },
+  { "output",
+    'o', 0,
+    G_OPTION_ARG_FILENAME,
+    &opt_output,
+    "Write the results to FILE instead of the standard output",
+    "FILE"
+  },
+
+  { NULL }
+};
+
+typedef struct
+{
+  ClutterActor *texture;
+  GstElement   *sink;
+  guint         painted;
+} Player;
+
+typedef struct
+{
+  GTimer  *timer;
+  gdouble  last;
+  gdouble  total;
+  gdouble  max;
+  guint    count;
+} Probe;
+
+static glong
+get_rss_kb (void)
+{
+  gchar *contents;
+  glong size, resident = 0;
+
+  if (!g_file_get_contents ("/proc/self/statm", &contents, NULL, NULL))
+    return 0;
+
+  if (sscanf (contents, "%ld %ld", &size, &resident) != 2)
+    resident = 0;
+  g_free (contents);
+
+  return resident * (sysconf (_SC_PAGESIZE) / 1024);
+}
+
+static guint
+get_n_threads (void)
+{
+  GDir *dir;
+  guint n_threads = 0;
+
+  dir = g_dir_open ("/proc/self/task", 0, NULL);
+  if (dir == NULL)
+    return 0;
+
+  while (g_dir_read_name (dir))
+    n_threads++;
+  g_dir_close (dir);
+
+  return n_threads;
+}
+
+static guint
+get_painted (GstElement *sink)
+{
+  GstStructure *stats;
+  guint painted = 0;
+
+  stats = clutter_gst_video_sink_get_stats (CLUTTER_GST_VIDEO_SINK (sink));
+  gst_structure_get_uint (stats, "painted", &painted);
+  gst_structure_free (stats);
+
+  return painted;
+}
+
+/* Writes CLIP_FRAMES frames of videotestsrc in an AVI file */
+static gchar *
+create_clip (void)
+{
+  GError *error = NULL;
+  GstElement *pipeline;
+  GstMessage *message;
+  GstBus *bus;
+  gchar *filename, *description;
+  gint fd;
+
+  fd = g_file_open_tmp ("bench-scale-XXXXXX.avi", &filename, &error);
+  if (fd == -1)
+    {
+      g_printerr ("%s\n", error->message);
+      g_error_free (error);
+      return NULL;
+    }
+  close (fd);
+
+  description = g_strdup_printf ("videotestsrc num-buffers=%d ! "
+                                 CLIP_CAPS ",width=%d,height=%d ! "
+                                 "avimux ! filesink location=\"%s\"",
+                                 CLIP_FRAMES, opt_width, opt_height,
+                                 filename);
+  pipeline = gst_parse_launch (description, &error);
+  g_free (description);
+
+  if (pipeline == NULL)
+    {
+      g_printerr ("%s\n", error->message);
+      g_error_free (error);
+      g_unlink (filename);
+      g_free (filename);
+      return NULL;
+    }
+
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+  bus = gst_pipeline_get_bus (GST_PIPELINE (pipeline));
+  message = gst_bus_timed_pop_filtered (bus, GST_CLOCK_TIME_NONE,
+                                        GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  if (GST_MESSAGE_TYPE (message) == GST_MESSAGE_ERROR)
+    {
+      g_printerr ("could not create the clip\n");
+      g_unlink (filename);
+      g_free (filename);
+      filename = NULL;
+    }
+
+  gst_message_unref (message);
+  gst_object_unref (bus);
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+
+  return filename;
+}
+
+static void
+on_eos (ClutterMedia *media,
+        gpointer      user_data)
+{
+  clutter_media_set_progress (media, 0.0);
+  clutter_media_set_playing (media, TRUE);
+}
+
+static Player *
+player_new (ClutterActor *stage,
+            const gchar  *uri)
+{
+  Player *player;
+  GstElement *pipeline;
+
+  player = g_new0 (Player, 1);
+  player->texture = clutter_gst_video_texture_new ();
+  g_signal_connect (player->texture, "eos", G_CALLBACK (on_eos), NULL);
+  clutter_container_add_actor (CLUTTER_CONTAINER (stage), player->texture);
+
+  pipeline = clutter_gst_video_texture_get_pipeline
+    (CLUTTER_GST_VIDEO_TEXTURE (player->texture));
+  g_object_get (pipeline, "video-sink", &player->sink, NULL);
+
+  clutter_media_set_uri (CLUTTER_MEDIA (player->texture), uri);
+  clutter_media_set_playing (CLUTTER_MEDIA (player->texture), TRUE);
+
+  return player;
+}
+
+static void
+player_free (Player *player)
+{
+  clutter_media_set_playing (CLUTTER_MEDIA (player->texture), FALSE);
+  gst_object_unref (player->sink);
+  clutter_actor_destroy (player->texture);
+  g_free (player);
+}
+
+/* Lays the textures out in a grid filling the stage */
+static void
+layout_players (GPtrArray *players)
+{
+  guint columns, rows, i;
+  gfloat width, height;
+
+  for (columns = 1; columns * columns < players->len; columns++)
+    ;
+  rows = (players->len + columns - 1) / columns;
+  width = (gfloat) STAGE_WIDTH / columns;
+  height = (gfloat) STAGE_HEIGHT / rows;
+
+  for (i = 0; i < players->len; i++)
+    {
+      Player *player = g_ptr_array_index (players, i);
+
+      clutter_actor_set_position (player->texture,
+                                  (i % columns) * width,
+                                  (i / columns) * height);
+      clutter_actor_set_size (player->texture, width, height);
+    }
+}
+
+static gboolean
+on_probe (gpointer user_data)
+{
+  Probe *probe = user_data;
+  gdouble now, lateness;
+
+  now = g_timer_elapsed (probe->timer, NULL);
+  lateness = now - probe->last - PROBE_INTERVAL / 1000.0;
+  probe->last = now;
+
+  if (lateness < 0)
+    lateness = 0;
+  probe->total += lateness;
+  probe->max = MAX (probe->max, lateness);
+  probe->count++;
+
+  return TRUE;
+}
+
+static gboolean
+on_timeout (gpointer user_data)
+{
+  clutter_main_quit ();
+
+  return FALSE;
+}
+
+static void
+run_for (gint seconds)
+{
+  g_timeout_add_seconds (seconds, on_timeout, NULL);
+  clutter_main ();
+}
+
+/* Measures the players for opt_duration seconds. The threads are the ones
+ * alive at the end, the short lived ones (typefinding, tasks of pads that
+ * went away) are not seen */
+static void
+measure_step (GPtrArray *players,
+              GString   *json,
+              gboolean   first)
+{
+  Probe probe = { 0, };
+  gdouble cpu, elapsed, fps, fps_total = 0, fps_min = G_MAXDOUBLE;
+  guint probe_id, i;
+
+  for (i = 0; i < players->len; i++)
+    {
+      Player *player = g_ptr_array_index (players, i);
+
+      player->painted = get_painted (player->sink);
+    }
+
+  probe.timer = g_timer_new ();
+  probe_id = g_timeout_add (PROBE_INTERVAL, on_probe, &probe);
+  cpu = bench_get_cpu_time ();
+
+  run_for (opt_duration);
+
+  elapsed = g_timer_elapsed (probe.timer, NULL);
+  cpu = bench_get_cpu_time () - cpu;
+  g_source_remove (probe_id);
+  g_timer_destroy (probe.timer);
+
+  for (i = 0; i < players->len; i++)
+    {
+      Player *player = g_ptr_array_index (players, i);
+
+      fps = (get_painted (player->sink) - player->painted) / elapsed;
+      fps_total += fps;
+      fps_min = MIN (fps_min, fps);
+    }
+
+  g_string_append_printf (json,
+                          "%s    { \"textures\": %u, \"rss-kb\": %ld, "
+                          "\"threads\": %u",
+                          first ? "" : ",\n", players->len, get_rss_kb (),
+                          get_n_threads ());
+  bench_append_double (json, "cpu-percent", cpu * 100 / elapsed);
+  bench_append_double (json, "dispatch-latency-mean-ms",
+                       probe.count ? probe.total * 1e3 / probe.count : 0);
+  bench_append_double (json, "dispatch-latency-max-ms", probe.max * 1e3);
+  bench_append_double (json, "fps-mean", fps_total / players->len);
+  bench_append_double (json, "fps-min", fps_min);
+  g_string_append (json, " }");
+}
+
+int
+main (int argc, char *argv[])
+{
+  GError *error = NULL;
+  ClutterActor *stage;
+  GPtrArray *players;
+  GString *json;
+  gchar *clip = NULL, *uri;
+  guint n_textures, max_textures;
+  guint i;
+
+  if (!g_thread_supported ())
+    g_thread_init (NULL);
+
+  clutter_gst_init_with_args (&argc,
+                              &argv,
+                              " - Measure how the library scales with the "
+                              "number of textures",
+                              options,
+                              NULL,
+                              &error);
+
+  if (error)
+    {
+      g_print ("%s\n", error->message);
+      g_error_free (error);
+      return EXIT_FAILURE;
+    }
+
+  if (opt_max_textures < 1)
+    {
+      g_print ("At least one texture is needed\n");
+      return EXIT_FAILURE;
+    }
+  max_textures = opt_max_textures;
+
+  if (opt_uri)
+    uri = g_strdup (opt_uri);
+  else
+    {
+      clip = create_clip ();
+      if (clip == NULL)
+        return EXIT_FAILURE;
+      uri = bench_get_uri (clip);
+    }
+
+  stage = clutter_stage_get_default ();
+  clutter_actor_set_size (stage, STAGE_WIDTH, STAGE_HEIGHT);
+  clutter_actor_show (stage);
+
+  json = g_string_new ("{\n  \"benchmark\": \"scale\",\n");
+  g_string_append_printf (json, "  \"uri\": \"%s\",\n", uri);
+  g_string_append (json, "  \"results\": [\n");
+
+  /* 1, 2, 4... textures, up to max_textures */
+  players = g_ptr_array_new ();
+  for (n_textures = 1; ; n_textures = MIN (n_textures * 2, max_textures))
+    {
+      while (players->len < n_textures)
+        g_ptr_array_add (players, player_new (stage, uri));
+      layout_players (players);
+
+      run_for (opt_settle);
+      measure_step (players, json, n_textures == 1);
+
+      if (n_textures >= max_textures)
+        break;
+    }
+
+  g_string_append (json, "\n  ]\n}\n");
+
+  for (i = 0; i < players->len; i++)
+    player_free (g_ptr_array_index (players, i));
+  g_ptr_array_free (players, TRUE);
+
+  if (clip)
+    {
+      g_unlink (clip);
+      g_free (clip);
+    }
+  g_free (uri);
+
+  if (!bench_write_json (json, opt_output))
+    return EXIT_FAILURE;
+
+  g_string_free (json, TRUE);
+
+  return EXIT_SUCCESS;
+}
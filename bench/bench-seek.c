@@ -0,0 +1,418 @@
+/*
+ * Clutter-GStreamer.
+ *
+ * GStreamer integration library for Clutter.
+ *
+ * bench-seek.c - Seek to random positions in files, with key unit and
+ * accurate seeks, and measure the time from the seek to ASYNC_DONE and to
+ * the first frame painted at the new position.
+ *
+ * Copyright (C) 2011 Intel Corporation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <stdlib.h>
+
+#include <clutter-gst/clutter-gst.h>
+
+#include "bench-common.h"
+
+/* a seek not done after that many seconds failed */
+#define SEEK_TIMEOUT 10
+
+/* upper bounds of the buckets of the histograms, in ms, the last bucket
+ * counts the seeks taking longer */
+static const gdouble bucket_bounds[] = { 10, 20, 50, 100, 200, 500, 1000 };
+#define N_BUCKETS (G_N_ELEMENTS (bucket_bounds) + 1)
+
+static const struct
+{
+  const gchar         *name;
+  ClutterGstSeekFlags  flags;
+} modes[] =
+{
+  { "key-unit", CLUTTER_GST_SEEK_FLAG_NONE },
+  { "accurate", CLUTTER_GST_SEEK_FLAG_ACCURATE }
+};
+
+static gint     opt_seeks  = 50;
+static gint     opt_seed   = 42;
+static gchar   *opt_output = NULL;
+
+static GOptionEntry options[] =
+{
+  { "seeks",
+    'n', 0,
+    G_OPTION_ARG_INT,
+    &opt_seeks,
+    "Number of seeks in each file, for each mode (default is 50)",
+    NULL
+  },
+  { "seed",
+    's', 0,
+    G_OPTION_ARG_INT,
+    &opt_seed,
+    "Seed of the random positions (default is 42)",
+    NULL
+  },
+  { "output",
+    'o', 0,
+    G_OPTION_ARG_FILENAME,
+    &opt_output,
+    "Write the results to FILE instead of the standard output",
+    "FILE"
+  },
+
+  { NULL }
+};
+
+typedef struct
+{
+  ClutterActor *texture;
+  GTimer       *timer;
+
+  /* of the seek in progress, in s since the seek. seek_start is negative
+   * while not seeking */
+  gdouble       seek_start;
+  gdouble       async_done;
+  gdouble       painted;
+  gboolean      got_frame;
+
+  /* in ms, for each seek done */
+  GArray       *async_done_times;
+  GArray       *paint_times;
+  gint          n_failed;
+} Bench;
+
+static void
+on_async_done (GstBus     *bus,
+               GstMessage *message,
+               Bench      *bench)
+{
+  if (bench->seek_start >= 0 && bench->async_done < 0)
+    bench->async_done = g_timer_elapsed (bench->timer, NULL) -
+                        bench->seek_start;
+}
+
+static void
+on_frame_latency (ClutterGstVideoSink   *sink,
+                  ClutterGstFrameTiming *timing,
+                  Bench                 *bench)
+{
+  bench->got_frame = TRUE;
+
+  if (bench->seek_start >= 0 && bench->painted < 0)
+    bench->painted = g_timer_elapsed (bench->timer, NULL) -
+                     bench->seek_start;
+}
+
+static void
+on_error (ClutterMedia *media,
+          GError       *error,
+          gpointer      user_data)
+{
+  g_printerr ("%s\n", error->message);
+}
+
+static gboolean
+has_frame (Bench *bench)
+{
+  return bench->got_frame;
+}
+
+static gboolean
+is_paused (Bench *bench)
+{
+  GstElement *pipeline;
+  GstState state;
+
+  pipeline = clutter_gst_video_texture_get_pipeline
+    (CLUTTER_GST_VIDEO_TEXTURE (bench->texture));
+
+  return gst_element_get_state (pipeline, &state, NULL, 0) ==
+           GST_STATE_CHANGE_SUCCESS &&
+         state == GST_STATE_PAUSED;
+}
+
+static gboolean
+is_seek_done (Bench *bench)
+{
+  return bench->async_done >= 0 && bench->painted >= 0;
+}
+
+static gboolean
+on_tick (gpointer user_data)
+{
+  return TRUE;
+}
+
+/* Runs the main loop until @done returns TRUE or @seconds have passed */
+static gboolean
+wait_until (gboolean (*done) (Bench *bench),
+            Bench     *bench,
+            gdouble    seconds)
+{
+  gdouble deadline;
+  guint tick_id;
+
+  deadline = g_timer_elapsed (bench->timer, NULL) + seconds;
+
+  /* wakes the main loop up, for the deadline */
+  tick_id = g_timeout_add (10, on_tick, NULL);
+  while (!done (bench) && g_timer_elapsed (bench->timer, NULL) < deadline)
+    g_main_context_iteration (NULL, TRUE);
+  g_source_remove (tick_id);
+
+  return done (bench);
+}
+
+/* Seeks opt_seeks times in @uri, paused */
+static gboolean
+run_mode (Bench               *bench,
+          ClutterActor        *stage,
+          const gchar         *uri,
+          ClutterGstSeekFlags  flags)
+{
+  GstElement *pipeline, *sink;
+  GstBus *bus;
+  GRand *rand;
+  gboolean ret = FALSE;
+  gint i;
+
+  bench->texture = clutter_gst_video_texture_new ();
+  clutter_actor_set_size (bench->texture,
+                          clutter_actor_get_width (stage),
+                          clutter_actor_get_height (stage));
+  clutter_container_add_actor (CLUTTER_CONTAINER (stage), bench->texture);
+  g_signal_connect (bench->texture, "error", G_CALLBACK (on_error), NULL);
+  clutter_gst_video_texture_set_seek_flags
+    (CLUTTER_GST_VIDEO_TEXTURE (bench->texture), flags);
+
+  pipeline = clutter_gst_video_texture_get_pipeline
+    (CLUTTER_GST_VIDEO_TEXTURE (bench->texture));
+  bus = gst_pipeline_get_bus (GST_PIPELINE (pipeline));
+  g_signal_connect (bus, "message::async-done",
+                    G_CALLBACK (on_async_done), bench);
+  gst_object_unref (bus);
+
+  g_object_get (pipeline, "video-sink", &sink, NULL);
+  g_object_set (sink, "trace-latency", TRUE, NULL);
+  g_signal_connect (sink, "frame-latency",
+                    G_CALLBACK (on_frame_latency), bench);
+
+  /* the player only seeks once it has been playing */
+  bench->seek_start = -1;
+  bench->got_frame = FALSE;
+  clutter_media_set_uri (CLUTTER_MEDIA (bench->texture), uri);
+  clutter_media_set_playing (CLUTTER_MEDIA (bench->texture), TRUE);
+  if (!wait_until (has_frame, bench, SEEK_TIMEOUT))
+    {
+      g_printerr ("%s: no frame shown\n", uri);
+      goto out;
+    }
+
+  clutter_media_set_playing (CLUTTER_MEDIA (bench->texture), FALSE);
+  if (!wait_until (is_paused, bench, SEEK_TIMEOUT))
+    {
+      g_printerr ("%s: could not pause\n", uri);
+      goto out;
+    }
+
+  /* the same positions for every mode */
+  rand = g_rand_new_with_seed (opt_seed);
+
+  for (i = 0; i < opt_seeks; i++)
+    {
+      gdouble progress, ms;
+
+      progress = g_rand_double_range (rand, 0.05, 0.95);
+
+      bench->async_done = bench->painted = -1;
+      bench->seek_start = g_timer_elapsed (bench->timer, NULL);
+      clutter_media_set_progress (CLUTTER_MEDIA (bench->texture), progress);
+
+      if (!wait_until (is_seek_done, bench, SEEK_TIMEOUT))
+        {
+          bench->n_failed++;
+
+          /* the late ASYNC_DONE and paint of this seek would be credited to
+           * the next one, let them come first. Past that the pipeline is
+           * stuck and the remaining seeks can't be measured */
+          if (!wait_until (is_seek_done, bench, SEEK_TIMEOUT))
+            {
+              g_printerr ("%s: seek %d never completed, skipping the "
+                          "remaining seeks\n", uri, i + 1);
+              bench->n_failed += opt_seeks - i - 1;
+              break;
+            }
+          continue;
+        }
+
+      ms = bench->async_done * 1e3;
+      g_array_append_val (bench->async_done_times, ms);
+      ms = bench->painted * 1e3;
+      g_array_append_val (bench->paint_times, ms);
+    }
+
+  bench->seek_start = -1;
+  g_rand_free (rand);
+  ret = TRUE;
+
+out:
+  clutter_media_set_playing (CLUTTER_MEDIA (bench->texture), FALSE);
+  gst_object_unref (sink);
+  clutter_actor_destroy (bench->texture);
+  bench->texture = NULL;
+
+  return ret;
+}
+
+/* Appends the statistics and the histogram of @times, sorting it */
+static void
+append_results (GString     *json,
+                gboolean     first,
+                const gchar *uri,
+                const gchar *mode,
+                const gchar *latency,
+                GArray      *times,
+                gint         n_failed)
+{
+  guint histogram[N_BUCKETS] = { 0, };
+  gdouble total = 0;
+  guint i, j;
+
+  g_array_sort (times, bench_compare_doubles);
+
+  for (i = 0; i < times->len; i++)
+    {
+      gdouble ms = g_array_index (times, gdouble, i);
+
+      for (j = 0; j < G_N_ELEMENTS (bucket_bounds); j++)
+        if (ms < bucket_bounds[j])
+          break;
+      histogram[j]++;
+      total += ms;
+    }
+
+  g_string_append_printf (json,
+                          "%s    { \"uri\": \"%s\", \"mode\": \"%s\", "
+                          "\"latency\": \"%s\", \"seeks\": %u, "
+                          "\"failed\": %d",
+                          first ? "" : ",\n", uri, mode, latency,
+                          times->len, n_failed);
+
+  if (times->len > 0)
+    {
+      bench_append_double (json, "min-ms", g_array_index (times, gdouble, 0));
+      bench_append_double (json, "median-ms",
+                           g_array_index (times, gdouble, times->len / 2));
+      bench_append_double (json, "mean-ms", total / times->len);
+      bench_append_double (json, "max-ms",
+                           g_array_index (times, gdouble, times->len - 1));
+    }
+
+  g_string_append (json, ", \"histogram\": [");
+  for (j = 0; j < N_BUCKETS; j++)
+    g_string_append_printf (json, "%s%u", j ? ", " : " ", histogram[j]);
+  g_string_append (json, " ] }");
+}
+
+int
+main (int argc, char *argv[])
+{
+  GError *error = NULL;
+  ClutterActor *stage;
+  Bench bench = { 0, };
+  GString *json;
+  gboolean first = TRUE;
+  gint i;
+  guint j;
+
+  if (!g_thread_supported ())
+    g_thread_init (NULL);
+
+  clutter_gst_init_with_args (&argc,
+                              &argv,
+                              " <file>... - Measure the latency of seeks",
+                              options,
+                              NULL,
+                              &error);
+
+  if (error)
+    {
+      g_print ("%s\n", error->message);
+      g_error_free (error);
+      return EXIT_FAILURE;
+    }
+
+  if (argc < 2)
+    {
+      g_print ("Usage: %s [OPTIONS] <file>...\n", argv[0]);
+      return EXIT_FAILURE;
+    }
+
+  stage = clutter_stage_get_default ();
+  clutter_actor_set_size (stage, 320, 240);
+  clutter_actor_show (stage);
+
+  bench.timer = g_timer_new ();
+  bench.async_done_times = g_array_new (FALSE, FALSE, sizeof (gdouble));
+  bench.paint_times = g_array_new (FALSE, FALSE, sizeof (gdouble));
+
+  json = g_string_new ("{\n  \"benchmark\": \"seek\",\n");
+  g_string_append_printf (json, "  \"seeks\": %d,\n", opt_seeks);
+  g_string_append (json, "  \"histogram-bounds-ms\": [");
+  for (j = 0; j < G_N_ELEMENTS (bucket_bounds); j++)
+    g_string_append_printf (json, "%s%.0f", j ? ", " : " ", bucket_bounds[j]);
+  g_string_append (json, " ],\n  \"results\": [\n");
+
+  for (i = 1; i < argc; i++)
+    {
+      gchar *uri = bench_get_uri (argv[i]);
+
+      for (j = 0; j < G_N_ELEMENTS (modes); j++)
+        {
+          g_array_set_size (bench.async_done_times, 0);
+          g_array_set_size (bench.paint_times, 0);
+          bench.n_failed = 0;
+
+          if (!run_mode (&bench, stage, uri, modes[j].flags))
+            continue;
+
+          append_results (json, first, uri, modes[j].name, "async-done",
+                          bench.async_done_times, bench.n_failed);
+          append_results (json, FALSE, uri, modes[j].name, "first-paint",
+                          bench.paint_times, bench.n_failed);
+          first = FALSE;
+        }
+
+      g_free (uri);
+    }
+
+  g_string_append (json, "\n  ]\n}\n");
+
+  g_array_free (bench.async_done_times, TRUE);
+  g_array_free (bench.paint_times, TRUE);
+  g_timer_destroy (bench.timer);
+
+  if (!bench_write_json (json, opt_output))
+    return EXIT_FAILURE;
+
+  g_string_free (json, TRUE);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,422 @@
+/*
+ * Clutter-GStreamer.
+ *
+ * GStreamer integration library for Clutter.
+ *
+ * bench-startup.c - Measure the time it takes to get the first frame of a
+ * file on screen, phase by phase, from the initialization of the library to
+ * the first paint. Each run happens in a new process so that every one of
+ * them is a cold start of the library.
+ *
+ * Copyright (C) 2011 Intel Corporation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+
+#include <clutter-gst/clutter-gst.h>
+
+#include "bench-common.h"
+
+/* a run not showing a frame after that many seconds failed */
+#define RUN_TIMEOUT 30
+
+enum
+{
+  PHASE_GST_INIT,               /* gst_init(), loads the registry */
+  PHASE_CLUTTER_GST_INIT,       /* clutter_gst_init(), clutter_init() */
+  PHASE_TEXTURE_NEW,            /* playbin2 and the sinks */
+  PHASE_SET_URI,
+  PHASE_PREROLL,                /* up to ASYNC_DONE */
+  PHASE_FIRST_PAINT,            /* from ASYNC_DONE to the first frame shown,
+                                 * 0 if it was shown before */
+  PHASE_TOTAL,
+
+  N_PHASES
+};
+
+static const gchar *phase_names[N_PHASES] =
+{
+  "gst-init",
+  "clutter-gst-init",
+  "texture-new",
+  "set-uri",
+  "preroll",
+  "first-paint",
+  "total"
+};
+
+static gint      opt_runs   = 5;
+static gchar    *opt_output = NULL;
+static gchar    *opt_child  = NULL;
+
+static GOptionEntry options[] =
+{
+  { "runs",
+    'n', 0,
+    G_OPTION_ARG_INT,
+    &opt_runs,
+    "Number of runs for each file (default is 5)",
+    NULL
+  },
+  { "output",
+    'o', 0,
+    G_OPTION_ARG_FILENAME,
+    &opt_output,
+    "Write the results to FILE instead of the standard output",
+    "FILE"
+  },
+  { "child",
+    0, G_OPTION_FLAG_HIDDEN,
+    G_OPTION_ARG_STRING,
+    &opt_child,
+    "Do one run with URI",
+    "URI"
+  },
+
+  { NULL }
+};
+
+/*
+ * One run, in a process of its own
+ */
+
+typedef struct
+{
+  GTimer  *timer;
+  gdouble  marks[N_PHASES];     /* start of each phase, the last one is
+                                 * the end of the run */
+  gint     phase;
+
+  /* the prerolled frame can be painted before ASYNC_DONE is dispatched,
+   * both are recorded as they come, -1 until then */
+  gdouble  async_done;
+  gdouble  first_paint;
+} Run;
+
+static void
+run_mark (Run *run)
+{
+  run->marks[++run->phase] = g_timer_elapsed (run->timer, NULL);
+}
+
+/* Ends the run once the pipeline prerolled and the first frame was
+ * painted, in whatever order. The first frame is on screen from the later
+ * of the two */
+static void
+run_check_first_paint (Run *run)
+{
+  if (run->async_done < 0 || run->first_paint < 0)
+    return;
+
+  run->marks[PHASE_FIRST_PAINT] = run->async_done;
+  run->marks[PHASE_TOTAL] = MAX (run->async_done, run->first_paint);
+  run->phase = PHASE_TOTAL;
+
+  clutter_main_quit ();
+}
+
+static void
+on_async_done (GstBus     *bus,
+               GstMessage *message,
+               Run        *run)
+{
+  /* seeks and state changes later on post ASYNC_DONE too */
+  if (run->phase == PHASE_PREROLL && run->async_done < 0)
+    {
+      run->async_done = g_timer_elapsed (run->timer, NULL);
+      run_check_first_paint (run);
+    }
+}
+
+static void
+on_frame_latency (ClutterGstVideoSink   *sink,
+                  ClutterGstFrameTiming *timing,
+                  Run                   *run)
+{
+  if (run->phase == PHASE_PREROLL && run->first_paint < 0)
+    {
+      run->first_paint = g_timer_elapsed (run->timer, NULL);
+      run_check_first_paint (run);
+    }
+}
+
+static void
+on_error (ClutterMedia *media,
+          GError       *error,
+          gpointer      user_data)
+{
+  g_printerr ("%s\n", error->message);
+  exit (EXIT_FAILURE);
+}
+
+static gboolean
+on_timeout (gpointer user_data)
+{
+  g_printerr ("no frame shown after %d seconds\n", RUN_TIMEOUT);
+  exit (EXIT_FAILURE);
+
+  return FALSE;
+}
+
+static int
+run_child (int argc, char *argv[], GTimer *timer)
+{
+  Run run = { 0, };
+  ClutterActor *stage, *texture;
+  GstElement *pipeline, *sink;
+  GstBus *bus;
+  GString *json;
+  gchar buffer[G_ASCII_DTOSTR_BUF_SIZE];
+  gint i;
+
+  run.timer = timer;
+  run.phase = -1;
+  run.async_done = run.first_paint = -1;
+  run_mark (&run);
+
+  gst_init (&argc, &argv);
+  run_mark (&run);
+
+  /* with the stage, that Clutter creates on first use */
+  if (clutter_gst_init (&argc, &argv) != CLUTTER_INIT_SUCCESS)
+    return EXIT_FAILURE;
+  stage = clutter_stage_get_default ();
+  clutter_actor_set_size (stage, 320, 240);
+  clutter_actor_show (stage);
+  run_mark (&run);
+
+  texture = clutter_gst_video_texture_new ();
+  run_mark (&run);
+
+  clutter_actor_set_size (texture, 320, 240);
+  clutter_container_add_actor (CLUTTER_CONTAINER (stage), texture);
+  g_signal_connect (texture, "error", G_CALLBACK (on_error), NULL);
+
+  pipeline = clutter_gst_video_texture_get_pipeline
+    (CLUTTER_GST_VIDEO_TEXTURE (texture));
+  bus = gst_pipeline_get_bus (GST_PIPELINE (pipeline));
+  g_signal_connect (bus, "message::async-done",
+                    G_CALLBACK (on_async_done), &run);
+  gst_object_unref (bus);
+
+  g_object_get (pipeline, "video-sink", &sink, NULL);
+  g_object_set (sink, "trace-latency", TRUE, NULL);
+  g_signal_connect (sink, "frame-latency",
+                    G_CALLBACK (on_frame_latency), &run);
+
+  clutter_media_set_uri (CLUTTER_MEDIA (texture), opt_child);
+  run_mark (&run);
+
+  clutter_media_set_playing (CLUTTER_MEDIA (texture), TRUE);
+  g_timeout_add_seconds (RUN_TIMEOUT, on_timeout, NULL);
+  clutter_main ();
+
+  /* one line, read back by the parent */
+  json = g_string_new ("{");
+  for (i = 0; i < N_PHASES; i++)
+    {
+      gdouble duration;
+
+      /* the timer was started when the process started */
+      if (i == PHASE_TOTAL)
+        duration = run.marks[PHASE_TOTAL];
+      else
+        duration = run.marks[i + 1] - run.marks[i];
+
+      g_string_append_printf (json, "%s\"%s\": %s",
+                              i ? ", " : " ", phase_names[i],
+                              g_ascii_formatd (buffer, sizeof (buffer),
+                                               "%.3f", duration * 1e3));
+    }
+  g_string_append (json, " }\n");
+  g_print ("%s", json->str);
+  g_string_free (json, TRUE);
+
+  clutter_media_set_playing (CLUTTER_MEDIA (texture), FALSE);
+  gst_object_unref (sink);
+
+  return EXIT_SUCCESS;
+}
+
+/*
+ * The runs, in child processes
+ */
+
+static gboolean
+spawn_run (const gchar *program,
+           const gchar *uri,
+           gdouble      durations[N_PHASES])
+{
+  GError *error = NULL;
+  gchar *argv[4], *child_uri, *output;
+  gint status, i;
+  gboolean ret = TRUE;
+
+  child_uri = g_strdup_printf ("--child=%s", uri);
+  argv[0] = (gchar *) program;
+  argv[1] = child_uri;
+  argv[2] = NULL;
+
+  if (!g_spawn_sync (NULL, argv, NULL, 0, NULL, NULL,
+                     &output, NULL, &status, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      g_error_free (error);
+      g_free (child_uri);
+      return FALSE;
+    }
+
+  if (!WIFEXITED (status) || WEXITSTATUS (status) != EXIT_SUCCESS)
+    ret = FALSE;
+
+  for (i = 0; ret && i < N_PHASES; i++)
+    {
+      gchar *key, *value;
+
+      key = g_strdup_printf ("\"%s\": ", phase_names[i]);
+      value = strstr (output, key);
+      if (value)
+        durations[i] = g_ascii_strtod (value + strlen (key), NULL);
+      else
+        ret = FALSE;
+      g_free (key);
+    }
+
+  g_free (output);
+  g_free (child_uri);
+
+  return ret;
+}
+
+/* Appends the statistics of each phase over the @n_runs of @uri */
+static void
+append_results (GString     *json,
+                gboolean     first,
+                const gchar *uri,
+                gdouble    (*runs)[N_PHASES],
+                gint         n_runs)
+{
+  gdouble *values;
+  gint i, j;
+
+  values = g_new (gdouble, n_runs);
+
+  for (i = 0; i < N_PHASES; i++)
+    {
+      gdouble total = 0;
+
+      for (j = 0; j < n_runs; j++)
+        {
+          values[j] = runs[j][i];
+          total += values[j];
+        }
+      qsort (values, n_runs, sizeof (gdouble), bench_compare_doubles);
+
+      g_string_append_printf (json,
+                              "%s    { \"uri\": \"%s\", \"phase\": \"%s\", "
+                              "\"runs\": %d",
+                              first && i == 0 ? "" : ",\n",
+                              uri, phase_names[i], n_runs);
+      bench_append_double (json, "min-ms", values[0]);
+      bench_append_double (json, "median-ms", values[n_runs / 2]);
+      bench_append_double (json, "mean-ms", total / n_runs);
+      bench_append_double (json, "max-ms", values[n_runs - 1]);
+      g_string_append (json, " }");
+    }
+
+  g_free (values);
+}
+
+int
+main (int argc, char *argv[])
+{
+  GError *error = NULL;
+  GOptionContext *context;
+  GTimer *timer;
+  GString *json;
+  gdouble (*runs)[N_PHASES];
+  gboolean first = TRUE;
+  gint i, n_runs;
+
+  /* started first thing, for the total of the child */
+  timer = g_timer_new ();
+
+  if (!g_thread_supported ())
+    g_thread_init (NULL);
+
+  /* the options of GStreamer and Clutter are left to the initialization of
+   * the child, so that it is measured */
+  context = g_option_context_new (" <file>... - Measure the time to the "
+                                  "first frame");
+  g_option_context_add_main_entries (context, options, NULL);
+  g_option_context_set_ignore_unknown_options (context, TRUE);
+  if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+      g_print ("%s\n", error->message);
+      g_error_free (error);
+      return EXIT_FAILURE;
+    }
+  g_option_context_free (context);
+
+  if (opt_child)
+    return run_child (argc, argv, timer);
+
+  if (argc < 2 || opt_runs < 1)
+    {
+      g_print ("Usage: %s [OPTIONS] <file>...\n", argv[0]);
+      return EXIT_FAILURE;
+    }
+
+  json = g_string_new ("{\n  \"benchmark\": \"startup\",\n");
+  g_string_append (json, "  \"results\": [\n");
+
+  runs = g_malloc (opt_runs * sizeof (*runs));
+
+  for (i = 1; i < argc; i++)
+    {
+      gchar *uri = bench_get_uri (argv[i]);
+
+      for (n_runs = 0; n_runs < opt_runs; n_runs++)
+        if (!spawn_run (argv[0], uri, runs[n_runs]))
+          {
+            g_printerr ("%s: run %d failed\n", uri, n_runs + 1);
+            break;
+          }
+
+      if (n_runs == opt_runs)
+        {
+          append_results (json, first, uri, runs, n_runs);
+          first = FALSE;
+        }
+
+      g_free (uri);
+    }
+
+  g_string_append (json, "\n  ]\n}\n");
+  g_free (runs);
+  g_timer_destroy (timer);
+
+  if (!bench_write_json (json, opt_output))
+    return EXIT_FAILURE;
+
+  g_string_free (json, TRUE);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,585 @@
+/*
+ * Clutter-GStreamer.
+ *
+ * GStreamer integration library for Clutter.
+ *
+ * bench-upload.c - Measure the throughput of cluttersink fed by
+ * videotestsrc, for every renderer, format and a range of frame sizes, and
+ * compare the results against a baseline.
+ *
+ * Copyright (C) 2011 Intel Corporation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <gst/video/video.h>
+#include <clutter-gst/clutter-gst.h>
+
+#include "bench-common.h"
+
+/* a sink not showing its first frame after that many seconds failed */
+#define PREROLL_TIMEOUT 10
+
+static gint     opt_frames    = 100;
+static gchar   *opt_output    = NULL;
+static gchar   *opt_baseline  = NULL;
+static gdouble  opt_tolerance = 0.1;
+
+static GOptionEntry options[] =
+{
+  { "frames",
+    'n', 0,
+    G_OPTION_ARG_INT,
+    &opt_frames,
+    "Number of frames pushed for each case (default is 100)",
+    NULL
+  },
+  { "output",
+    'o', 0,
+    G_OPTION_ARG_FILENAME,
+    &opt_output,
+    "Write the results to FILE instead of the standard output",
+    "FILE"
+  },
+  { "baseline",
+    'b', 0,
+    G_OPTION_ARG_FILENAME,
+    &opt_baseline,
+    "Compare the results with the ones of an earlier run",
+    "FILE"
+  },
+  { "tolerance",
+    't', 0,
+    G_OPTION_ARG_DOUBLE,
+    &opt_tolerance,
+    "Relative change against the baseline reported as a regression "
+    "(default is 0.1)",
+    NULL
+  },
+
+  { NULL }
+};
+
+static const struct
+{
+  gint width;
+  gint height;
+} sizes[] =
+{
+  {  320,  240 },
+  {  640,  480 },
+  { 1280,  720 },
+  { 1920, 1080 },
+  { 3840, 2160 }
+};
+
+/* fps counts the frames uploaded. The CPU time and the allocations are
+ * those of the whole process, videotestsrc included, they are divided by
+ * the frames the sink received, the frames superseded in the mailbox
+ * before being uploaded (dropped) cost their generation too */
+typedef struct
+{
+  gdouble fps;
+  gdouble cpu_per_frame;        /* in µs */
+  gdouble allocs_per_frame;
+  guint   dropped;
+} Result;
+
+/*
+ * Allocations are counted by routing the GLib allocator through our own
+ * functions, with the slice allocator falling back to it
+ */
+
+static volatile gint n_allocs;
+
+static gpointer
+counting_malloc (gsize n_bytes)
+{
+  g_atomic_int_inc (&n_allocs);
+  return malloc (n_bytes);
+}
+
+static gpointer
+counting_realloc (gpointer mem,
+                  gsize    n_bytes)
+{
+  if (mem == NULL)
+    g_atomic_int_inc (&n_allocs);
+  return realloc (mem, n_bytes);
+}
+
+static gpointer
+counting_calloc (gsize n_blocks,
+                 gsize n_block_bytes)
+{
+  g_atomic_int_inc (&n_allocs);
+  return calloc (n_blocks, n_block_bytes);
+}
+
+static GMemVTable counting_vtable =
+{
+  counting_malloc,
+  counting_realloc,
+  free,
+  counting_calloc,
+  NULL,
+  NULL
+};
+
+static const gchar *
+get_format_name (GstCaps *caps)
+{
+  GstVideoFormat format;
+
+  if (!gst_video_format_parse_caps (caps, &format, NULL, NULL))
+    return "unknown";
+
+  switch (format)
+    {
+    case GST_VIDEO_FORMAT_RGB:  return "RGB";
+    case GST_VIDEO_FORMAT_BGR:  return "BGR";
+    case GST_VIDEO_FORMAT_RGBA: return "RGBA";
+    case GST_VIDEO_FORMAT_BGRA: return "BGRA";
+    case GST_VIDEO_FORMAT_I420: return "I420";
+    case GST_VIDEO_FORMAT_YV12: return "YV12";
+    case GST_VIDEO_FORMAT_NV12: return "NV12";
+    case GST_VIDEO_FORMAT_NV21: return "NV21";
+    case GST_VIDEO_FORMAT_AYUV: return "AYUV";
+    case GST_VIDEO_FORMAT_YUY2: return "YUY2";
+    case GST_VIDEO_FORMAT_UYVY: return "UYVY";
+    default:                    return "unknown";
+    }
+}
+
+/* Returns the counter @name of the statistics of @sink */
+static guint
+get_stat (GstElement  *sink,
+          const gchar *name)
+{
+  GstStructure *stats;
+  guint value = 0;
+
+  stats = clutter_gst_video_sink_get_stats (CLUTTER_GST_VIDEO_SINK (sink));
+  gst_structure_get_uint (stats, name, &value);
+  gst_structure_free (stats);
+
+  return value;
+}
+
+static gboolean
+on_tick (gpointer user_data)
+{
+  return TRUE;
+}
+
+static gboolean
+on_bus_message (GstBus     *bus,
+                GstMessage *message,
+                gpointer    user_data)
+{
+  gboolean *failed = user_data;
+
+  switch (GST_MESSAGE_TYPE (message))
+    {
+    case GST_MESSAGE_ERROR:
+      *failed = TRUE;
+      /* fall through */
+    case GST_MESSAGE_EOS:
+      clutter_main_quit ();
+      break;
+
+    default:
+      break;
+    }
+
+  return TRUE;
+}
+
+/* Pushes opt_frames frames of @caps to a sink using @renderer, returns
+ * FALSE if they could not be displayed */
+static gboolean
+run_case (ClutterActor *texture,
+          const gchar  *renderer,
+          GstCaps      *caps,
+          Result       *result)
+{
+  GstElement *pipeline, *src, *filter, *sink;
+  GstBus *bus;
+  GTimer *timer;
+  guint watch_id, tick_id;
+  gboolean failed = FALSE;
+  gdouble cpu, elapsed;
+  guint received, uploaded, dropped;
+  gint allocs;
+
+  pipeline = gst_pipeline_new (NULL);
+  src = gst_element_factory_make ("videotestsrc", NULL);
+  filter = gst_element_factory_make ("capsfilter", NULL);
+  sink = clutter_gst_video_sink_new (CLUTTER_TEXTURE (texture));
+
+  g_object_set (src, "num-buffers", opt_frames + 1, NULL);
+  g_object_set (filter, "caps", caps, NULL);
+  g_object_set (sink,
+                "renderer", renderer,
+                "sync", FALSE,
+                "qos", FALSE,
+                NULL);
+
+  gst_bin_add_many (GST_BIN (pipeline), src, filter, sink, NULL);
+  gst_element_link_many (src, filter, sink, NULL);
+
+  bus = gst_pipeline_get_bus (GST_PIPELINE (pipeline));
+  watch_id = gst_bus_add_watch (bus, on_bus_message, &failed);
+
+  /* the first frame sets up the renderer, it is not measured. Prerolling
+   * only gets it in the mailbox, the renderer is set up and the frame
+   * uploaded once the clutter thread picks it */
+  gst_element_set_state (pipeline, GST_STATE_PAUSED);
+  if (gst_element_get_state (pipeline, NULL, NULL, GST_CLOCK_TIME_NONE) !=
+      GST_STATE_CHANGE_SUCCESS)
+    {
+      failed = TRUE;
+      goto out;
+    }
+
+  timer = g_timer_new ();
+  tick_id = g_timeout_add (10, on_tick, NULL);
+  while (get_stat (sink, "uploaded") == 0 && !failed &&
+         g_timer_elapsed (timer, NULL) < PREROLL_TIMEOUT)
+    g_main_context_iteration (NULL, TRUE);
+  g_source_remove (tick_id);
+  g_timer_destroy (timer);
+
+  if (failed || get_stat (sink, "uploaded") == 0)
+    {
+      failed = TRUE;
+      goto out;
+    }
+
+  received = get_stat (sink, "received");
+  uploaded = get_stat (sink, "uploaded");
+  dropped = get_stat (sink, "dropped");
+  allocs = g_atomic_int_get (&n_allocs);
+  cpu = bench_get_cpu_time ();
+  timer = g_timer_new ();
+
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+  clutter_main ();
+
+  elapsed = g_timer_elapsed (timer, NULL);
+  g_timer_destroy (timer);
+  cpu = bench_get_cpu_time () - cpu;
+  allocs = g_atomic_int_get (&n_allocs) - allocs;
+  received = get_stat (sink, "received") - received;
+  uploaded = get_stat (sink, "uploaded") - uploaded;
+  dropped = get_stat (sink, "dropped") - dropped;
+
+  if (uploaded == 0)
+    failed = TRUE;
+  else
+    {
+      result->fps = uploaded / elapsed;
+      result->cpu_per_frame = cpu * 1e6 / received;
+      result->allocs_per_frame = (gdouble) allocs / received;
+      result->dropped = dropped;
+    }
+
+out:
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  g_source_remove (watch_id);
+  gst_object_unref (bus);
+  gst_object_unref (pipeline);
+
+  return !failed;
+}
+
+/*
+ * Results, written as JSON with one case per line so that the baseline can
+ * be read back without a JSON parser
+ */
+
+static gchar *
+get_case_key (const gchar *renderer,
+              const gchar *format,
+              gint         width,
+              gint         height)
+{
+  return g_strdup_printf ("%s/%s/%dx%d", renderer, format, width, height);
+}
+
+static void
+append_result (GString      *json,
+               gboolean      first,
+               const gchar  *renderer,
+               const gchar  *format,
+               gint          width,
+               gint          height,
+               const Result *result)
+{
+  g_string_append_printf (json,
+                          "%s    { \"renderer\": \"%s\", \"format\": \"%s\", "
+                          "\"width\": %d, \"height\": %d",
+                          first ? "" : ",\n", renderer, format, width, height);
+  bench_append_double (json, "fps", result->fps);
+  bench_append_double (json, "cpu-us-per-frame", result->cpu_per_frame);
+  bench_append_double (json, "allocs-per-frame", result->allocs_per_frame);
+  g_string_append_printf (json, ", \"dropped\": %u }", result->dropped);
+}
+
+static GHashTable *
+load_baseline (const gchar *filename)
+{
+  GError *error = NULL;
+  GHashTable *baseline;
+  GMatchInfo *match;
+  GRegex *regex;
+  gchar *contents;
+
+  if (!g_file_get_contents (filename, &contents, NULL, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      g_error_free (error);
+      return NULL;
+    }
+
+  baseline = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+  regex = g_regex_new ("\"renderer\": \"([^\"]*)\", \"format\": \"([^\"]*)\", "
+                       "\"width\": (\\d+), \"height\": (\\d+), "
+                       "\"fps\": ([0-9.]+), "
+                       "\"cpu-us-per-frame\": ([0-9.]+), "
+                       "\"allocs-per-frame\": ([0-9.]+)",
+                       0, 0, NULL);
+
+  g_regex_match (regex, contents, 0, &match);
+  while (g_match_info_matches (match))
+    {
+      gchar *field[8];
+      Result *result;
+      gint i;
+
+      for (i = 1; i < 8; i++)
+        field[i] = g_match_info_fetch (match, i);
+
+      result = g_new (Result, 1);
+      result->fps = g_ascii_strtod (field[5], NULL);
+      result->cpu_per_frame = g_ascii_strtod (field[6], NULL);
+      result->allocs_per_frame = g_ascii_strtod (field[7], NULL);
+      result->dropped = 0;
+
+      g_hash_table_insert (baseline,
+                           get_case_key (field[1], field[2],
+                                         atoi (field[3]), atoi (field[4])),
+                           result);
+
+      for (i = 1; i < 8; i++)
+        g_free (field[i]);
+
+      g_match_info_next (match, NULL);
+    }
+
+  g_match_info_free (match);
+  g_regex_unref (regex);
+  g_free (contents);
+
+  return baseline;
+}
+
+/* Returns TRUE if @result is worse than @base by more than the tolerance */
+static gboolean
+compare_result (const gchar  *key,
+                const Result *result,
+                const Result *base)
+{
+  gboolean regressed = FALSE;
+
+  if (result->fps < base->fps * (1 - opt_tolerance))
+    {
+      g_printerr ("%s: %.1f fps, was %.1f\n", key, result->fps, base->fps);
+      regressed = TRUE;
+    }
+
+  if (result->cpu_per_frame > base->cpu_per_frame * (1 + opt_tolerance))
+    {
+      g_printerr ("%s: %.1f us of CPU per frame, was %.1f\n",
+                  key, result->cpu_per_frame, base->cpu_per_frame);
+      regressed = TRUE;
+    }
+
+  /* a frame more or less is noise on small counts */
+  if (result->allocs_per_frame >
+      base->allocs_per_frame * (1 + opt_tolerance) + 1)
+    {
+      g_printerr ("%s: %.1f allocations per frame, was %.1f\n",
+                  key, result->allocs_per_frame, base->allocs_per_frame);
+      regressed = TRUE;
+    }
+
+  return regressed;
+}
+
+int
+main (int argc, char *argv[])
+{
+  GError *error = NULL;
+  GHashTable *baseline = NULL;
+  ClutterActor *stage, *texture, *probe_texture;
+  GstElement *probe;
+  GstCaps *sink_caps;
+  GString *json;
+  gchar **renderers;
+  gboolean first = TRUE;
+  gint n_regressions = 0;
+  guint i, j, k;
+
+  /* has to come before anything allocates */
+  g_mem_set_vtable (&counting_vtable);
+  g_setenv ("G_SLICE", "always-malloc", TRUE);
+
+  if (!g_thread_supported ())
+    g_thread_init (NULL);
+
+  clutter_gst_init_with_args (&argc,
+                              &argv,
+                              " - Measure the upload throughput of the sink",
+                              options,
+                              NULL,
+                              &error);
+
+  if (error)
+    {
+      g_print ("%s\n", error->message);
+      g_error_free (error);
+      return EXIT_FAILURE;
+    }
+
+  if (opt_baseline)
+    {
+      baseline = load_baseline (opt_baseline);
+      if (baseline == NULL)
+        return EXIT_FAILURE;
+    }
+
+  /* the sink does not upload the frames of a texture that can't be seen,
+   * the stage has to be shown */
+  stage = clutter_stage_get_default ();
+  clutter_actor_set_size (stage, 320, 240);
+
+  texture = g_object_new (CLUTTER_TYPE_TEXTURE,
+                          "disable-slicing", TRUE,
+                          NULL);
+  clutter_actor_set_size (texture, 320, 240);
+  clutter_container_add_actor (CLUTTER_CONTAINER (stage), texture);
+  clutter_actor_show_all (stage);
+
+  /* a sink of its own, never played, tells what renderers there are and
+   * the formats each of them handles */
+  probe_texture = g_object_ref_sink (clutter_texture_new ());
+  probe = clutter_gst_video_sink_new (CLUTTER_TEXTURE (probe_texture));
+  gst_object_ref_sink (probe);
+  g_object_get (probe, "renderers", &renderers, NULL);
+
+  json = g_string_new ("{\n  \"benchmark\": \"upload\",\n");
+  g_string_append_printf (json, "  \"frames\": %d,\n", opt_frames);
+  g_string_append (json, "  \"results\": [\n");
+
+  for (i = 0; renderers[i]; i++)
+    {
+      GstPad *pad;
+
+      /* the formats the renderer handles */
+      g_object_set (probe, "renderer", renderers[i], NULL);
+      pad = gst_element_get_static_pad (probe, "sink");
+      sink_caps = gst_pad_get_caps (pad);
+      gst_object_unref (pad);
+
+      for (j = 0; j < gst_caps_get_size (sink_caps); j++)
+        for (k = 0; k < G_N_ELEMENTS (sizes); k++)
+          {
+            GstStructure *structure;
+            GstCaps *caps;
+            Result result;
+            const gchar *format;
+
+            structure = gst_structure_copy (gst_caps_get_structure (sink_caps,
+                                                                    j));
+            gst_structure_set (structure,
+                               "width", G_TYPE_INT, sizes[k].width,
+                               "height", G_TYPE_INT, sizes[k].height,
+                               "framerate", GST_TYPE_FRACTION, 30, 1,
+                               "pixel-aspect-ratio", GST_TYPE_FRACTION, 1, 1,
+                               NULL);
+            caps = gst_caps_new_full (structure, NULL);
+            format = get_format_name (caps);
+
+            if (run_case (texture, renderers[i], caps, &result))
+              {
+                append_result (json, first, renderers[i], format,
+                               sizes[k].width, sizes[k].height, &result);
+                first = FALSE;
+
+                if (baseline)
+                  {
+                    gchar *key;
+                    Result *base;
+
+                    key = get_case_key (renderers[i], format,
+                                        sizes[k].width, sizes[k].height);
+                    base = g_hash_table_lookup (baseline, key);
+                    if (base && compare_result (key, &result, base))
+                      n_regressions++;
+                    g_free (key);
+                  }
+              }
+            else
+              {
+                g_printerr ("%s renderer: could not display %dx%d %s\n",
+                            renderers[i], sizes[k].width, sizes[k].height,
+                            format);
+              }
+
+            gst_caps_unref (caps);
+          }
+
+      gst_caps_unref (sink_caps);
+    }
+
+  g_string_append (json, "\n  ]\n}\n");
+
+  if (!bench_write_json (json, opt_output))
+    return EXIT_FAILURE;
+
+  g_string_free (json, TRUE);
+  g_strfreev (renderers);
+  gst_object_unref (probe);
+  g_object_unref (probe_texture);
+
+  if (baseline)
+    {
+      g_hash_table_destroy (baseline);
+
+      if (n_regressions > 0)
+        {
+          g_printerr ("%d regressions against %s\n",
+                      n_regressions, opt_baseline);
+          return EXIT_FAILURE;
+        }
+    }
+
+  return EXIT_SUCCESS;
+}
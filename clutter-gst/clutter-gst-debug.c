@@ -41,7 +41,8 @@ static const GDebugKey clutter_gst_debug_keys[] = {
   { "aspect-ratio", CLUTTER_GST_DEBUG_ASPECT_RATIO },
   { "buffering",    CLUTTER_GST_DEBUG_BUFFERING    },
   { "audio-stream", CLUTTER_GST_DEBUG_AUDIO_STREAM },
-  { "subtitles",    CLUTTER_GST_DEBUG_SUBTITLES    }
+  { "subtitles",    CLUTTER_GST_DEBUG_SUBTITLES    },
+  { "latency",      CLUTTER_GST_DEBUG_LATENCY      }
 };
 
 /**
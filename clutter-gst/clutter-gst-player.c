@@ -182,6 +182,11 @@ struct _ClutterGstPlayerPrivate
 
   GList *audio_streams;
   GList *subtitle_tracks;
+
+  /* the pad of the video sink whose caps decide who deinterlaces, set
+   * from the streaming thread with the object lock of the pipeline */
+  GstPad *video_sink_pad;
+  gulong video_sink_caps_id;
 };
 
 static GQuark clutter_gst_player_private_quark = 0;
@@ -1029,6 +1034,191 @@ on_source_changed (GstElement       *pipeline,
   player_set_user_agent (player, priv->user_agent);
 }
 
+/* playbin2 deinterlaces with a CPU element when GST_PLAY_FLAG_DEINTERLACE
+ * is set. cluttersink deinterlaces some formats on the GPU, listed in its
+ * "deinterlace-caps" property. Once the caps of the stream are negotiated,
+ * and when they are in one of those formats, the CPU element is switched
+ * to passthrough and the sink does the work instead. The flags of the
+ * application are left alone */
+static gint
+is_deinterlacer (GstElement *element,
+                 gpointer    user_data)
+{
+  GstElementFactory *factory = gst_element_get_factory (element);
+
+  if (factory &&
+      strcmp (GST_PLUGIN_FEATURE_NAME (factory), "deinterlace") == 0)
+    return 0;
+
+  gst_object_unref (element);
+  return 1;
+}
+
+/* Whether @video_sink can deinterlace frames with @caps */
+static gboolean
+video_sink_can_deinterlace (GstElement *video_sink,
+                            GstCaps    *caps)
+{
+  GstCaps *deinterlace_caps = NULL;
+  GParamSpec *pspec;
+  gboolean ret;
+
+  if (!g_object_class_find_property (G_OBJECT_GET_CLASS (video_sink),
+                                     "deinterlace-caps"))
+    return FALSE;
+
+  /* a sink deinterlacing with a mode we don't know of is left alone */
+  pspec = g_object_class_find_property (G_OBJECT_GET_CLASS (video_sink),
+                                        "deinterlace-mode");
+  if (pspec == NULL ||
+      G_PARAM_SPEC_VALUE_TYPE (pspec) != CLUTTER_GST_TYPE_DEINTERLACE_MODE)
+    return FALSE;
+
+  g_object_get (video_sink, "deinterlace-caps", &deinterlace_caps, NULL);
+  if (deinterlace_caps == NULL)
+    return FALSE;
+
+  ret = gst_caps_can_intersect (caps, deinterlace_caps);
+  gst_caps_unref (deinterlace_caps);
+
+  return ret;
+}
+
+/* Called from the streaming thread when the caps of the video sink are
+ * negotiated, the caps at the input of the CPU deinterlacer are then the
+ * ones of the decoded stream */
+static void
+on_video_sink_caps_changed (GstPad           *pad,
+                            GParamSpec       *pspec,
+                            ClutterGstPlayer *player)
+{
+  ClutterGstPlayerPrivate *priv = PLAYER_GET_PRIVATE (player);
+  GstElement *video_sink, *deinterlacer;
+  GstIterator *it;
+  GstPad *deinterlacer_pad;
+  GstCaps *caps;
+  ClutterGstDeinterlaceMode mode;
+  gboolean in_sink, disabled;
+
+  if (priv == NULL)
+    return;
+
+  it = gst_bin_iterate_recurse (GST_BIN (priv->pipeline));
+  deinterlacer = gst_iterator_find_custom (it, (GCompareFunc) is_deinterlacer,
+                                           NULL);
+  gst_iterator_free (it);
+
+  if (deinterlacer == NULL)
+    return;
+
+  deinterlacer_pad = gst_element_get_static_pad (deinterlacer, "sink");
+  caps = gst_pad_get_negotiated_caps (deinterlacer_pad);
+  gst_object_unref (deinterlacer_pad);
+
+  /* nothing to decide from until the stream has caps */
+  if (caps == NULL)
+    goto out;
+
+  video_sink = gst_pad_get_parent_element (pad);
+  in_sink = video_sink_can_deinterlace (video_sink, caps);
+  gst_caps_unref (caps);
+
+  /* the mode of the deinterlacer is only given back if we changed it */
+  disabled = g_object_get_data (G_OBJECT (deinterlacer),
+                                "clutter-gst-in-sink") != NULL;
+
+  if (in_sink && !disabled)
+    {
+      CLUTTER_GST_NOTE (MEDIA, "deinterlacing in the video sink");
+
+      /* the mode of the sink is given back along with the work, if we
+       * changed it */
+      g_object_get (video_sink, "deinterlace-mode", &mode, NULL);
+      if (mode == CLUTTER_GST_DEINTERLACE_MODE_NONE)
+        {
+          g_object_set_data (G_OBJECT (video_sink),
+                             "clutter-gst-deinterlace-mode",
+                             GINT_TO_POINTER (mode + 1));
+          g_object_set (video_sink,
+                        "deinterlace-mode",
+                        CLUTTER_GST_DEINTERLACE_MODE_MOTION_ADAPTIVE,
+                        NULL);
+        }
+
+      g_object_set_data (G_OBJECT (deinterlacer), "clutter-gst-in-sink",
+                         GINT_TO_POINTER (TRUE));
+      gst_util_set_object_arg (G_OBJECT (deinterlacer), "mode", "disabled");
+    }
+  else if (!in_sink && disabled)
+    {
+      CLUTTER_GST_NOTE (MEDIA, "deinterlacing with %s",
+                        GST_ELEMENT_NAME (deinterlacer));
+
+      g_object_set_data (G_OBJECT (deinterlacer), "clutter-gst-in-sink", NULL);
+      gst_util_set_object_arg (G_OBJECT (deinterlacer), "mode", "auto");
+
+      /* stored off by one so that NONE is not mistaken for unset */
+      mode = GPOINTER_TO_INT (g_object_get_data (G_OBJECT (video_sink),
+                                                 "clutter-gst-deinterlace-mode"));
+      if (mode > 0)
+        {
+          g_object_set_data (G_OBJECT (video_sink),
+                             "clutter-gst-deinterlace-mode", NULL);
+          g_object_set (video_sink, "deinterlace-mode", mode - 1, NULL);
+        }
+    }
+
+  gst_object_unref (video_sink);
+
+out:
+  gst_object_unref (deinterlacer);
+}
+
+/* Called from the streaming thread when playbin2 is about to set up its
+ * video chain, follows the caps of the video sink in use */
+static void
+on_video_changed (GstElement       *pipeline,
+                  ClutterGstPlayer *player)
+{
+  ClutterGstPlayerPrivate *priv = PLAYER_GET_PRIVATE (player);
+  GstElement *video_sink;
+  GstPad *pad;
+
+  if (priv == NULL)
+    return;
+
+  g_object_get (pipeline, "video-sink", &video_sink, NULL);
+  if (video_sink == NULL)
+    return;
+
+  pad = gst_element_get_static_pad (video_sink, "sink");
+  gst_object_unref (video_sink);
+
+  if (pad == NULL)
+    return;
+
+  GST_OBJECT_LOCK (pipeline);
+
+  if (pad != priv->video_sink_pad)
+    {
+      if (priv->video_sink_pad)
+        {
+          g_signal_handler_disconnect (priv->video_sink_pad,
+                                       priv->video_sink_caps_id);
+          gst_object_unref (priv->video_sink_pad);
+        }
+
+      priv->video_sink_pad = gst_object_ref (pad);
+      priv->video_sink_caps_id =
+        g_signal_connect (pad, "notify::caps",
+                          G_CALLBACK (on_video_sink_caps_changed), player);
+    }
+
+  GST_OBJECT_UNLOCK (pipeline);
+
+  gst_object_unref (pad);
+}
+
 static void
 query_duration (ClutterGstPlayer *player)
 {
@@ -1938,6 +2128,8 @@ clutter_gst_player_init (ClutterGstPlayer *player)
 
   g_signal_connect (priv->pipeline, "notify::source",
                     G_CALLBACK (on_source_changed), player);
+  g_signal_connect (priv->pipeline, "video-changed",
+                    G_CALLBACK (on_video_changed), player);
 
   /* We default to not playing until someone calls set_playing(TRUE) */
   priv->target_state = GST_STATE_PAUSED;
@@ -2041,6 +2233,14 @@ clutter_gst_player_deinit (ClutterGstPlayer *player)
 
   gst_element_set_state (priv->pipeline, GST_STATE_NULL);
 
+  if (priv->video_sink_pad)
+    {
+      g_signal_handler_disconnect (priv->video_sink_pad,
+                                   priv->video_sink_caps_id);
+      gst_object_unref (priv->video_sink_pad);
+      priv->video_sink_pad = NULL;
+    }
+
   if (priv->bus)
     {
       gst_bus_remove_signal_watch (priv->bus);
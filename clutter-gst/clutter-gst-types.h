@@ -62,4 +62,26 @@ typedef enum _ClutterGstBufferingMode
   CLUTTER_GST_BUFFERING_MODE_DOWNLOAD
 } ClutterGstBufferingMode;
 
+/**
+ * ClutterGstDeinterlaceMode:
+ * @CLUTTER_GST_DEINTERLACE_MODE_NONE: Show interlaced frames as they are
+ * @CLUTTER_GST_DEINTERLACE_MODE_BOB: Interpolate the missing lines from the
+ *   lines of the field shown
+ * @CLUTTER_GST_DEINTERLACE_MODE_LINEAR: Blend the lines of both fields
+ * @CLUTTER_GST_DEINTERLACE_MODE_MOTION_ADAPTIVE: Keep the lines of the other
+ *   field where the picture does not move, interpolate them elsewhere
+ *
+ * How #ClutterGstVideoSink deinterlaces interlaced frames on the GPU, see
+ * #ClutterGstVideoSink:deinterlace-mode.
+ *
+ * Since: 1.6
+ */
+typedef enum _ClutterGstDeinterlaceMode
+{
+  CLUTTER_GST_DEINTERLACE_MODE_NONE,
+  CLUTTER_GST_DEINTERLACE_MODE_BOB,
+  CLUTTER_GST_DEINTERLACE_MODE_LINEAR,
+  CLUTTER_GST_DEINTERLACE_MODE_MOTION_ADAPTIVE
+} ClutterGstDeinterlaceMode;
+
 #endif /* __CLUTTER_GST_TYPES_H__ */
@@ -36,14 +36,20 @@
  *
  * #ClutterGstVideoSink is a GStreamer sink element that sends
  * data to a #ClutterTexture.
+ *
+ * The sink implements #GstColorBalance. The brightness, contrast, hue and
+ * saturation of YUV frames are adjusted on the GPU, along with the
+ * conversion to RGB, which follows the "color-matrix" field of the caps.
  */
 
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif
 
+#include "clutter-gst-debug.h"
 #include "clutter-gst-video-sink.h"
 #include "clutter-gst-video-texture.h"
+#include "clutter-gst-enum-types.h"
 #include "clutter-gst-private.h"
 #include "clutter-gst-shaders.h"
 
@@ -57,10 +63,12 @@
 #include <gst/gstvalue.h>
 #include <gst/video/video.h>
 #include <gst/video/gstvideosink.h>
+#include <gst/interfaces/colorbalance.h>
 #include <gst/interfaces/navigation.h>
 #include <gst/riff/riff-ids.h>
 
 #include <glib.h>
+#include <math.h>
 #include <string.h>
 
 /* Flags to give to cogl_texture_new(). Since clutter 1.1.10 put NO_ATLAS to
@@ -72,41 +80,206 @@
 #define CLUTTER_GST_TEXTURE_FLAGS  COGL_TEXTURE_NO_SLICING
 #endif
 
+/* Frames are uploaded into a ring of textures that are allocated once and
+ * then updated in place. We keep enough textures around so that the one we
+ * are updating is never the one the GPU may still be sampling from for the
+ * previous frame(s) */
+#define CLUTTER_GST_TEXTURE_RING_SIZE   3
+
+/* the textures of the ring can be updated from pixel buffers */
+#if defined (HAVE_COGL_BITMAP_NEW_FROM_BUFFER) && \
+    defined (HAVE_COGL_TEXTURE_SET_REGION_FROM_BITMAP)
+#define CLUTTER_GST_HAVE_PBO_UPLOADS 1
+#endif
+
+#define CLUTTER_GST_MAX_PLANES          3
+#define CLUTTER_GST_MAX_GEOMETRY_UNIFORMS 4
+
+/* The YUV shaders leave the conversion to RGB to a colour matrix applied
+ * to the (y, u, v, 1) samples. The sink builds it from the colorimetry of
+ * the stream and the colour balance settings, so changing those never
+ * needs another program */
+#define YUV_TO_RGBA_VARS                                                      \
+     "uniform mat4 yuv_matrix;"
+
+#define YUV_TO_RGBA(y, u, v)                                                  \
+     "  vec4 color = yuv_matrix * vec4 (" y ", " u ", " v ", 1.0);"
+
 static gchar *ayuv_to_rgba_shader = \
      FRAGMENT_SHADER_VARS
+     YUV_TO_RGBA_VARS
      "uniform sampler2D tex;"
      "void main () {"
-     "  vec4 color = texture2D (tex, vec2(" TEX_COORD "));"
-     "  float y = 1.1640625 * (color.g - 0.0625);"
-     "  float u = color.b - 0.5;"
-     "  float v = color.a - 0.5;"
-     "  color.a = color.r;"
-     "  color.r = y + 1.59765625 * v;"
-     "  color.g = y - 0.390625 * u - 0.8125 * v;"
-     "  color.b = y + 2.015625 * u;"
+     "  vec4 texel = texture2D (tex, vec2(" TEX_COORD "));"
+     YUV_TO_RGBA ("texel.g", "texel.b", "texel.a")
+     "  color.a = texel.r;"
      "  gl_FragColor = color;"
      FRAGMENT_SHADER_END
      "}";
 
 static gchar *yv12_to_rgba_shader = \
      FRAGMENT_SHADER_VARS
+     YUV_TO_RGBA_VARS
      "uniform sampler2D ytex;"
      "uniform sampler2D utex;"
      "uniform sampler2D vtex;"
      "void main () {"
      "  vec2 coord = vec2(" TEX_COORD ");"
-     "  float y = 1.1640625 * (texture2D (ytex, coord).g - 0.0625);"
-     "  float u = texture2D (utex, coord).g - 0.5;"
-     "  float v = texture2D (vtex, coord).g - 0.5;"
-     "  vec4 color;"
-     "  color.r = y + 1.59765625 * v;"
-     "  color.g = y - 0.390625 * u - 0.8125 * v;"
-     "  color.b = y + 2.015625 * u;"
-     "  color.a = 1.0;"
+     "  float y = texture2D (ytex, coord).g;"
+     "  float u = texture2D (utex, coord).g;"
+     "  float v = texture2D (vtex, coord).g;"
+     YUV_TO_RGBA ("y", "u", "v")
      "  gl_FragColor = color;"
      FRAGMENT_SHADER_END
      "}";
 
+/* NV12 and NV21 have a Y plane followed by a plane of interleaved 2x2
+ * subsampled chroma samples. That plane is uploaded as a luminance texture
+ * as wide as the Y plane and sampled with the nearest filter; the shader
+ * picks the U and V texels of the pair the fragment belongs to, hence the
+ * width of the texture as uniform */
+#define NV12_TO_RGBA_SHADER(u_offset, v_offset)                               \
+     FRAGMENT_SHADER_VARS                                                     \
+     YUV_TO_RGBA_VARS                                                         \
+     "uniform sampler2D ytex;"                                                \
+     "uniform sampler2D uvtex;"                                               \
+     "uniform float width;"                                                   \
+     "void main () {"                                                         \
+     "  vec2 coord = vec2(" TEX_COORD ");"                                    \
+     "  float x = 2.0 * floor (coord.x * width / 2.0);"                       \
+     "  float y = texture2D (ytex, coord).g;"                                 \
+     "  float u = texture2D (uvtex,"                                          \
+     "                       vec2 ((x + " u_offset ") / width, coord.y)).g;"  \
+     "  float v = texture2D (uvtex,"                                          \
+     "                       vec2 ((x + " v_offset ") / width, coord.y)).g;"  \
+     YUV_TO_RGBA ("y", "u", "v")                                              \
+     "  gl_FragColor = color;"                                                \
+     FRAGMENT_SHADER_END                                                      \
+     "}"
+
+/* I420 and YV12 frames uploaded as a single luminance texture, the planes
+ * stacked on top of each other. A row of the texture holds two rows of
+ * chroma samples, so the chroma texels are addressed explicitly (and always
+ * sampled at their center) */
+#define PLANAR_TO_RGBA_SHADER(u_plane, v_plane)                               \
+     FRAGMENT_SHADER_VARS                                                     \
+     YUV_TO_RGBA_VARS                                                         \
+     "uniform sampler2D tex;"                                                 \
+     "uniform vec2 size;"          /* size of the picture */                  \
+     "uniform vec2 tex_size;"      /* size of the texture */                  \
+     "uniform vec2 chroma_size;"   /* size of a chroma plane */               \
+     "uniform float chroma_row;"   /* first row of the chroma planes */       \
+     "float chroma (vec2 coord, float plane) {"                               \
+     "  vec2 c = min (floor (coord * chroma_size), chroma_size - 1.0);"       \
+     "  float row = plane * chroma_size.y + c.y;"                             \
+     "  vec2 t = vec2 (c.x + mod (row, 2.0) * tex_size.x / 2.0 + 0.5,"        \
+     "                 chroma_row + floor (row / 2.0) + 0.5);"                \
+     "  return texture2D (tex, t / tex_size).g;"                              \
+     "}"                                                                      \
+     "void main () {"                                                         \
+     "  vec2 coord = vec2(" TEX_COORD ");"                                    \
+     "  float y = texture2D (tex, coord * size / tex_size).g;"                \
+     "  float u = chroma (coord, " u_plane ");"                               \
+     "  float v = chroma (coord, " v_plane ");"                               \
+     YUV_TO_RGBA ("y", "u", "v")                                              \
+     "  gl_FragColor = color;"                                                \
+     FRAGMENT_SHADER_END                                                      \
+     "}"
+
+static gchar *i420_single_to_rgba_shader = PLANAR_TO_RGBA_SHADER ("0.0", "1.0");
+static gchar *yv12_single_to_rgba_shader = PLANAR_TO_RGBA_SHADER ("1.0", "0.0");
+
+static gchar *nv12_to_rgba_shader = NV12_TO_RGBA_SHADER ("0.5", "1.5");
+static gchar *nv21_to_rgba_shader = NV12_TO_RGBA_SHADER ("1.5", "0.5");
+
+/* YUY2 and UYVY are packed formats with 2 pixels per 4 bytes macropixel
+ * (Y0 U Y1 V for YUY2, U Y0 V Y1 for UYVY). The frames are uploaded as a
+ * RGBA texture half as wide as the frame, one texel per macropixel. The
+ * shader always samples the center of the texels so the macropixels are
+ * not blended together whatever the filter used by the texture and then
+ * picks the luma sample of the pixel */
+#define YUY2_TO_RGBA_SHADER(y0, u, y1, v)                                     \
+     FRAGMENT_SHADER_VARS                                                     \
+     YUV_TO_RGBA_VARS                                                         \
+     "uniform sampler2D tex;"                                                 \
+     "uniform float width;"                                                   \
+     "void main () {"                                                         \
+     "  vec2 coord = vec2(" TEX_COORD ");"                                    \
+     "  float x = coord.x * width;"                                           \
+     "  vec4 texel = texture2D (tex,"                                         \
+     "                          vec2 ((floor (x) + 0.5) / width, coord.y));"  \
+     "  float y = mix (texel." y0 ", texel." y1 ", step (0.5, fract (x)));"   \
+     "  float u = texel." u ";"                                               \
+     "  float v = texel." v ";"                                               \
+     YUV_TO_RGBA ("y", "u", "v")                                              \
+     "  gl_FragColor = color;"                                                \
+     FRAGMENT_SHADER_END                                                      \
+     "}"
+
+static gchar *yuy2_to_rgba_shader = YUY2_TO_RGBA_SHADER ("r", "g", "b", "a");
+static gchar *uyvy_to_rgba_shader = YUY2_TO_RGBA_SHADER ("g", "r", "a", "b");
+
+/* Interlaced I420 and YV12 frames. The lines of the field being shown
+ * (field is the parity of its lines) are used as they are, the other ones
+ * are rebuilt by the deinterlacing method. prevtex is the luma plane of the
+ * previous frame, used to detect motion */
+#define DEINTERLACE_SHADER(u_tex, v_tex, method)                              \
+     FRAGMENT_SHADER_VARS                                                     \
+     YUV_TO_RGBA_VARS                                                         \
+     "uniform sampler2D ytex;"                                                \
+     "uniform sampler2D utex;"                                                \
+     "uniform sampler2D vtex;"                                                \
+     "uniform sampler2D prevtex;"                                             \
+     "uniform float height;"       /* number of luma lines */                 \
+     "uniform float field;"        /* parity of the lines shown */            \
+     "vec2 line (vec2 coord, float l, float lines) {"                         \
+     "  return vec2 (coord.x, (l + 0.5) / lines);"                            \
+     "}"                                                                      \
+     "float deinterlace (sampler2D tex, vec2 coord, float lines,"             \
+     "                   float motion) {"                                     \
+     "  float l = min (floor (coord.y * lines), lines - 1.0);"                \
+     "  float cur = texture2D (tex, line (coord, l, lines)).g;"               \
+     "  float above = texture2D (tex, line (coord,"                           \
+     "                 l > 0.0 ? l - 1.0 : l + 1.0, lines)).g;"               \
+     "  float below = texture2D (tex, line (coord,"                           \
+     "                 l < lines - 1.0 ? l + 1.0 : l - 1.0, lines)).g;"       \
+     "  bool in_field = abs (mod (l, 2.0) - field) < 0.5;"                    \
+     method                                                                   \
+     "}"                                                                      \
+     "void main () {"                                                         \
+     "  vec2 coord = vec2(" TEX_COORD ");"                                    \
+     "  float motion = smoothstep (0.02, 0.1,"                                \
+     "                             abs (texture2D (ytex, coord).g -"          \
+     "                                  texture2D (prevtex, coord).g));"      \
+     "  float chroma_lines = ceil (height / 2.0);"                            \
+     "  float y = deinterlace (ytex, coord, height, motion);"                 \
+     "  float u = deinterlace (" u_tex ", coord, chroma_lines, motion);"      \
+     "  float v = deinterlace (" v_tex ", coord, chroma_lines, motion);"      \
+     YUV_TO_RGBA ("y", "u", "v")                                              \
+     "  gl_FragColor = color;"                                                \
+     FRAGMENT_SHADER_END                                                      \
+     "}"
+
+#define DEINTERLACE_BOB                                                       \
+     "  return in_field ? cur : (above + below) * 0.5;"
+#define DEINTERLACE_LINEAR                                                    \
+     "  return (above + 2.0 * cur + below) * 0.25;"
+#define DEINTERLACE_MOTION_ADAPTIVE                                           \
+     "  return in_field ? cur : mix (cur, (above + below) * 0.5, motion);"
+
+/* indexed by ClutterGstDeinterlaceMode, I420 then YV12 (where the first
+ * chroma plane, uploaded in utex, is V) */
+static gchar *deinterlace_shaders[][2] =
+{
+  { NULL, NULL },
+  { DEINTERLACE_SHADER ("utex", "vtex", DEINTERLACE_BOB),
+    DEINTERLACE_SHADER ("vtex", "utex", DEINTERLACE_BOB) },
+  { DEINTERLACE_SHADER ("utex", "vtex", DEINTERLACE_LINEAR),
+    DEINTERLACE_SHADER ("vtex", "utex", DEINTERLACE_LINEAR) },
+  { DEINTERLACE_SHADER ("utex", "vtex", DEINTERLACE_MOTION_ADAPTIVE),
+    DEINTERLACE_SHADER ("vtex", "utex", DEINTERLACE_MOTION_ADAPTIVE) }
+};
+
 static GstStaticPadTemplate sinktemplate_all
  = GST_STATIC_PAD_TEMPLATE ("sink",
                             GST_PAD_SINK,
@@ -114,6 +287,10 @@ static GstStaticPadTemplate sinktemplate_all
                             GST_STATIC_CAPS (GST_VIDEO_CAPS_YUV("AYUV") ";" \
                                              GST_VIDEO_CAPS_YUV("YV12") ";" \
                                              GST_VIDEO_CAPS_YUV("I420") ";" \
+                                             GST_VIDEO_CAPS_YUV("NV12") ";" \
+                                             GST_VIDEO_CAPS_YUV("NV21") ";" \
+                                             GST_VIDEO_CAPS_YUV("YUY2") ";" \
+                                             GST_VIDEO_CAPS_YUV("UYVY") ";" \
                                              GST_VIDEO_CAPS_RGBA        ";" \
                                              GST_VIDEO_CAPS_BGRA        ";" \
                                              GST_VIDEO_CAPS_RGB         ";" \
@@ -134,9 +311,31 @@ enum
 {
   PROP_0,
   PROP_TEXTURE,
-  PROP_UPDATE_PRIORITY
+  PROP_UPDATE_PRIORITY,
+  PROP_BUFFER_POOL_SIZE,
+  PROP_BUFFER_POOL_STATS,
+  PROP_USE_PIXEL_BUFFERS,
+  PROP_UPLOAD_ON_PAINT,
+  PROP_DEINTERLACE_MODE,
+  PROP_DEINTERLACE_DOUBLE_RATE,
+  PROP_DEINTERLACE_CAPS,
+  PROP_DOWNSCALE_THRESHOLD,
+  PROP_STATS,
+  PROP_STATS_INTERVAL,
+  PROP_TRACE_LATENCY,
+  PROP_RENDERER,
+  PROP_RENDERERS
+};
+
+enum
+{
+  FRAME_LATENCY,
+
+  LAST_SIGNAL
 };
 
+static guint video_sink_signals[LAST_SIGNAL] = { 0, };
+
 typedef enum
 {
   CLUTTER_GST_NOFORMAT,
@@ -145,8 +344,52 @@ typedef enum
   CLUTTER_GST_AYUV,
   CLUTTER_GST_YV12,
   CLUTTER_GST_I420,
+  CLUTTER_GST_NV12,
+  CLUTTER_GST_NV21,
+  CLUTTER_GST_YUY2,
+  CLUTTER_GST_UYVY,
 } ClutterGstVideoFormat;
 
+/* indexed by ClutterGstVideoFormat */
+static const char *clutter_gst_video_format_names[] =
+{
+  "none",
+  "RGB32",
+  "RGB24",
+  "AYUV",
+  "YV12",
+  "I420",
+  "NV12",
+  "NV21",
+  "YUY2",
+  "UYVY"
+};
+
+/*
+ * Layout of a plane in the frames, as uploaded in a texture of the ring.
+ * For packed formats width is the number of texels of the texture which is
+ * not necessarily the number of pixels (eg. YUY2).
+ */
+typedef struct _ClutterGstPlane
+{
+  gsize offset;      /* offset of the plane in the buffer */
+  gint  rowstride;   /* bytes between two rows, padding included */
+  gint  width;       /* width of the texture, in texels */
+  gint  height;
+} ClutterGstPlane;
+
+/*
+ * Uniform of a program depending on the geometry of the frames, see
+ * _set_geometry_uniform().
+ */
+typedef struct _ClutterGstGeometryUniform
+{
+  const char *name;
+  int         location;
+  int         n_components;
+  gfloat      value[2];
+} ClutterGstGeometryUniform;
+
 /*
  * features: what does the underlaying video card supports ?
  */
@@ -168,10 +411,50 @@ typedef struct _ClutterGstSource
   GSource              source;
 
   ClutterGstVideoSink *sink;
-  GMutex              *buffer_lock;   /* mutex for the buffer */
-  GstBuffer           *buffer;
+  GstBuffer * volatile buffer;        /* mailbox, only accessed atomically */
 } ClutterGstSource;
 
+/*
+ * Pool of frame memory handed to upstream elements through buffer_alloc.
+ *
+ * The memory blocks are recycled when the GstBuffer wrapping them is freed
+ * (the free function of the buffer gets them back to the pool). Blocks that
+ * are in use hold a reference on the pool, so the pool can outlive the sink.
+ */
+
+#define CLUTTER_GST_DEFAULT_BUFFER_POOL_SIZE  4
+
+typedef struct _ClutterGstBufferPool
+{
+  volatile gint  ref_count;
+  GMutex        *lock;
+
+  GSList        *free_blocks;     /* blocks ready to be reused */
+  guint          n_free;
+  guint          max_free;        /* maximum number of blocks kept around */
+  gsize          block_size;      /* size of the frames we are pooling */
+
+  guint          n_allocated;     /* number of blocks alive */
+  guint64        allocated_bytes;
+  guint64        high_water_bytes;
+  guint64        hits;
+  guint64        misses;
+} ClutterGstBufferPool;
+
+typedef struct _ClutterGstBufferBlock
+{
+  ClutterGstBufferPool *pool;
+  gsize                 size;
+} ClutterGstBufferBlock;
+
+/* keep the frame data 16 bytes aligned after the header */
+#define CLUTTER_GST_BLOCK_HEADER_SIZE \
+  GST_ROUND_UP_16 (sizeof (ClutterGstBufferBlock))
+#define CLUTTER_GST_BLOCK_DATA(block) \
+  ((guint8 *) (block) + CLUTTER_GST_BLOCK_HEADER_SIZE)
+#define CLUTTER_GST_DATA_BLOCK(data) \
+  ((ClutterGstBufferBlock *) ((guint8 *) (data) - CLUTTER_GST_BLOCK_HEADER_SIZE))
+
 /*
  * renderer: abstracts a backend to render a frame.
  */
@@ -190,6 +473,9 @@ typedef struct _ClutterGstRenderer
  void (*deinit)     (ClutterGstVideoSink *sink);
  void (*upload)     (ClutterGstVideoSink *sink,
                      GstBuffer           *buffer);
+
+ /* optional, can the renderer handle the negotiated frames? */
+ gboolean (*accept) (ClutterGstVideoSink *sink);
 } ClutterGstRenderer;
 
 typedef enum _ClutterGstRendererState
@@ -199,40 +485,496 @@ typedef enum _ClutterGstRendererState
   CLUTTER_GST_RENDERER_NEED_GC,
 } ClutterGstRendererState;
 
+/*
+ * The pixel buffer the streaming thread copies the next frame into, see
+ * clutter_gst_video_sink_stage()
+ */
+typedef enum _ClutterGstStageState
+{
+  CLUTTER_GST_STAGE_NONE,       /* nothing mapped */
+  CLUTTER_GST_STAGE_READY,      /* mapped, waiting for a frame */
+  CLUTTER_GST_STAGE_COPYING,    /* a frame is being copied */
+  CLUTTER_GST_STAGE_STAGED      /* holds stage_buffer */
+} ClutterGstStageState;
+
+/*
+ * Colour balance, see the GstColorBalance implementation at the end
+ */
+typedef enum
+{
+  CLUTTER_GST_BALANCE_BRIGHTNESS,
+  CLUTTER_GST_BALANCE_CONTRAST,
+  CLUTTER_GST_BALANCE_HUE,
+  CLUTTER_GST_BALANCE_SATURATION,
+
+  CLUTTER_GST_N_BALANCE_CHANNELS
+} ClutterGstBalanceChannel;
+
+/* indexed by ClutterGstBalanceChannel */
+static const char *clutter_gst_balance_channel_names[] =
+{
+  "BRIGHTNESS",
+  "CONTRAST",
+  "HUE",
+  "SATURATION"
+};
+
+#define CLUTTER_GST_BALANCE_MIN   -1000
+#define CLUTTER_GST_BALANCE_MAX    1000
+
+/* The upload times are counted in buckets, the first one for uploads
+ * taking less than 250us, each of the next ones twice as wide as the
+ * previous one, the last one for the uploads taking 32ms or more */
+#define CLUTTER_GST_N_UPLOAD_BUCKETS     9
+#define CLUTTER_GST_UPLOAD_BUCKET_0_US   250
+
+/* number of frame timings kept when tracing the latency */
+#define CLUTTER_GST_TIMING_RING_SIZE     256
+
+/*
+ * Last values of the uniforms set on a shared program, the sinks showing
+ * frames with the same colour balance, field and geometry don't need to set
+ * them again (and flush the geometry queued with the previous values), see
+ * clutter_gst_video_sink_set_uniforms()
+ */
+typedef struct _ClutterGstProgramUniforms
+{
+  gboolean                  set;
+  gfloat                    yuv_matrix[16];
+  gfloat                    field;
+  gfloat                    height;
+  ClutterGstGeometryUniform geometry[CLUTTER_GST_MAX_GEOMETRY_UNIFORMS];
+  guint                     n_geometry;
+} ClutterGstProgramUniforms;
+
+/*
+ * Registry of the renderers usable with the GL context of clutter, shared
+ * by all the sinks of the process. Probing the GL features, building the
+ * caps and linking the GL programs of the renderers are done once instead
+ * of once per sink. Clutter uses a single GL context for all its stages, so
+ * one registry is enough.
+ */
+typedef struct _ClutterGstRendererRegistry
+{
+  volatile gint  ref_count;
+
+  gint           features;        /* ClutterGstFeatures of the GL context */
+  GSList        *renderers;
+  GstCaps       *caps;
+
+  /* linked programs keyed by renderer name, followed by the deinterlacing
+   * variant for the renderers that have some. Only accessed from the
+   * clutter thread */
+  GHashTable    *programs;
+  /* ClutterGstProgramUniforms keyed by program. Only accessed from the
+   * clutter thread */
+  GHashTable    *uniforms;
+
+  /* renderer autotuning: the features and the fastest renderer for each
+   * format measured with the GL driver and the version of the library
+   * named by tuning_group, as cached on disk. Protected by the registry
+   * lock */
+  gboolean       autotune;
+  gchar         *tuning_group;
+  GKeyFile      *tuning;
+} ClutterGstRendererRegistry;
+
+G_LOCK_DEFINE_STATIC (renderer_registry);
+static ClutterGstRendererRegistry *renderer_registry = NULL;
+
 struct _ClutterGstVideoSinkPrivate
 {
   ClutterTexture          *texture;
+
+  /* more textures showing the frames uploaded for texture, they all share
+   * its material. input_actor is the one receiving the navigation event
+   * being sent, if any. Only accessed from the clutter thread */
+  GSList                  *textures;
+  ClutterActor            *input_actor;
+  volatile gint            textures_par_dirty;
   CoglMaterial            *material_template;
+  gboolean                 autotuning;      /* keep off the textures */
+  CoglHandle               program;         /* owned by the registry */
+  gchar                   *program_source;
+  gint                     program_n_samplers;
 
   ClutterGstVideoFormat    format;
   gboolean                 bgr;
   int                      width;
   int                      height;
+  ClutterGstPlane          planes[CLUTTER_GST_MAX_PLANES];
+  guint                    n_planes;
+  gsize                    frame_size;
   int                      fps_n, fps_d;
   int                      par_n, par_d;
 
   GMainContext            *clutter_main_context;
   ClutterGstSource        *source;
 
-  GSList                  *renderers;
+  /* when uploading on paint, the frame waiting for the next repaint. Only
+   * accessed from the clutter thread */
+  gboolean                 upload_on_paint;
+  GstBuffer               *pending_buffer;
+  guint                    repaint_func_id;
+
+  /* frames replaced by a newer one before having been uploaded */
+  volatile gint            dropped_frames;
+
+  /* frame statistics, see clutter_gst_video_sink_get_stats(). The counters
+   * are updated from both threads, the upload times and rates only from
+   * the clutter thread, under stats_lock. frame_painted tells whether the
+   * last frame uploaded has been painted yet */
+  volatile gint            frames_received;
+  volatile gint            frames_superseded;
+  volatile gint            frames_uploaded;
+  volatile gint            frames_painted;
+  gboolean                 frame_painted;
+  GstBuffer               *prerolled_buffer; /* only compared, no ref */
+  GMutex                  *stats_lock;
+  GTimer                  *stats_timer;
+  guint                    upload_histogram[CLUTTER_GST_N_UPLOAD_BUCKETS];
+  gdouble                  upload_time_total;
+  gdouble                  upload_time_max;
+  guint64                  bytes_uploaded;
+  guint64                  window_bytes;
+  gdouble                  window_start;
+  gdouble                  bytes_per_second;
+  guint                    stats_interval;
+  GSource                 *stats_source;
+
+  /* latency tracing. The streaming thread stores the timing of the buffer
+   * it hands to the clutter thread in render_timing, both under
+   * trace_lock, so that the clutter thread gets the timing of the very
+   * buffer it picks up. next_timing is the timing of the frame about to be
+   * uploaded, pending_timing the one of pending_buffer and timing the one
+   * of the frame shown, only accessed from the clutter thread. The last
+   * timings are kept in timing_ring, under stats_lock */
+  gboolean                 trace_latency;
+  GMutex                  *trace_lock;
+  GstBuffer               *render_buffer;
+  ClutterGstFrameTiming    render_timing;
+  ClutterGstFrameTiming    next_timing;
+  ClutterGstFrameTiming    pending_timing;
+  ClutterGstFrameTiming    timing;
+  ClutterGstFrameTiming    timing_ring[CLUTTER_GST_TIMING_RING_SIZE];
+  guint                    timing_ring_index;
+  guint                    n_timings;
+
+  /* set by the clutter thread when the texture can't be seen (unmapped,
+   * transparent or outside of the stage) and has not been painted since the
+   * last check, read by the streaming thread to ask upstream to skip
+   * frames. A texture can be painted while off-stage by a ClutterClone, so
+   * a paint always counts as visible, see painted_since_check. qos_enabled
+   * is the QoS setting of the base sink to restore once the texture shows
+   * again */
+  volatile gint            hidden;
+  gboolean                 painted_since_check;
+  gboolean                 qos_enabled;
+
+  ClutterGstRendererRegistry *registry;
+  GSList                  *renderers;       /* owned by the registry */
   GstCaps                 *caps;
   ClutterGstRenderer      *renderer;
   ClutterGstRendererState  renderer_state;
+  /* set with the renderer property, the caps are restricted to the ones
+   * of that renderer */
+  ClutterGstRenderer      *forced_renderer;
 
   GArray                  *signal_handler_ids;
+
+  /* colour balance channels and their values, indexed by
+   * ClutterGstBalanceChannel. The values are set from any thread, the
+   * matrix is rebuilt in the clutter thread when yuv_matrix_dirty is set */
+  GList                   *balance_channels;
+  volatile gint            balance[CLUTTER_GST_N_BALANCE_CHANNELS];
+  volatile gint            hdtv;            /* BT.709 colorimetry */
+  volatile gint            yuv_matrix_dirty;
+  volatile gint            balance_redraw_queued;
+  gfloat                   yuv_matrix[16];
+  int                      yuv_matrix_location;
+
+  /* deinterlacing. field is the parity of the lines of the field shown,
+   * second_field the timeout showing the other field of the frame in
+   * double rate mode. Only accessed from the clutter thread, but for the
+   * properties */
+  gboolean                 interlaced;
+  ClutterGstDeinterlaceMode deinterlace_mode;
+  gboolean                 deinterlace_double_rate;
+  gfloat                   field;
+  GSource                 *second_field;
+  int                      field_location;
+  int                      height_location;
+
+  /* the uniforms of the program depending on the geometry of the frames.
+   * The programs are shared between sinks, the values are set before each
+   * paint like the colour matrix. Only accessed from the clutter thread */
+  ClutterGstGeometryUniform geometry[CLUTTER_GST_MAX_GEOMETRY_UNIFORMS];
+  guint                    n_geometry;
+
+  /* downscaling of the frames to the size they are shown at. scale is the
+   * power of two upstream is asked to divide the size of its frames by, as
+   * decided by the clutter thread once the allocation of the texture has
+   * settled. native_width and native_height are the size of the frames
+   * upstream produces on its own, scaled_width and scaled_height the size
+   * last asked for, only accessed from the streaming thread */
+  gdouble                  downscale_threshold;
+  volatile gint            scale;
+  volatile gint            native_width;
+  volatile gint            native_height;
+  int                      scaled_width;
+  int                      scaled_height;
+  GSource                 *downscale_timeout;
+
+  ClutterGstBufferPool    *pool;
+
+  /* texture ring, only accessed from the clutter thread. The ring is
+   * (re)allocated when the format or the size of the frames changes */
+  CoglHandle               ring[CLUTTER_GST_TEXTURE_RING_SIZE]
+                               [CLUTTER_GST_MAX_PLANES];
+  CoglMaterial            *ring_material[CLUTTER_GST_TEXTURE_RING_SIZE];
+  CoglHandle               ring_pbo[CLUTTER_GST_TEXTURE_RING_SIZE];
+  gsize                    ring_pbo_size[CLUTTER_GST_TEXTURE_RING_SIZE];
+  gboolean                 ring_pbo_staged;
+
+  /* the pixel buffer of the next slot of the ring, mapped by the clutter
+   * thread for the streaming thread to copy the next frame into while the
+   * clutter thread is busy with the previous one. Protected by stage_lock,
+   * stage_cond is signalled when a copy is over */
+  GMutex                  *stage_lock;
+  GCond                   *stage_cond;
+  ClutterGstStageState     stage_state;
+  guint8                  *stage_data;
+  gsize                    stage_size;
+  guint                    stage_slot;
+  GstBuffer               *stage_buffer;
+
+  /* stream the frames through pixel buffers. use_pbo is the value of the
+   * property, pbo_available is only valid once pbo_checked is set */
+  gboolean                 use_pbo;
+  gboolean                 pbo_checked;
+  gboolean                 pbo_available;
+  guint                    ring_index;
+  ClutterGstVideoFormat    ring_format;
+  gboolean                 ring_bgr;
+  int                      ring_width;
+  int                      ring_height;
 };
 
-#define GstNavigationClass GstNavigationInterface
-GST_BOILERPLATE_WITH_INTERFACE (ClutterGstVideoSink,
-                                clutter_gst_video_sink,
-                                GstBaseSink,
-                                GST_TYPE_BASE_SINK,
-                                GstNavigation,
-                                GST_TYPE_NAVIGATION,
-                                clutter_gst_navigation);
+static void
+clutter_gst_implements_interface_init (GstImplementsInterfaceClass *klass);
+static void
+clutter_gst_navigation_interface_init (GstNavigationInterface *iface);
+static void
+clutter_gst_color_balance_interface_init (GstColorBalanceClass *klass);
+
+static void
+clutter_gst_video_sink_do_init (GType type)
+{
+  static const GInterfaceInfo implements_info = {
+    (GInterfaceInitFunc) clutter_gst_implements_interface_init, NULL, NULL
+  };
+  static const GInterfaceInfo navigation_info = {
+    (GInterfaceInitFunc) clutter_gst_navigation_interface_init, NULL, NULL
+  };
+  static const GInterfaceInfo color_balance_info = {
+    (GInterfaceInitFunc) clutter_gst_color_balance_interface_init, NULL, NULL
+  };
+
+  g_type_add_interface_static (type, GST_TYPE_IMPLEMENTS_INTERFACE,
+                               &implements_info);
+  g_type_add_interface_static (type, GST_TYPE_NAVIGATION, &navigation_info);
+  g_type_add_interface_static (type, GST_TYPE_COLOR_BALANCE,
+                               &color_balance_info);
+}
+
+GST_BOILERPLATE_FULL (ClutterGstVideoSink,
+                      clutter_gst_video_sink,
+                      GstBaseSink,
+                      GST_TYPE_BASE_SINK,
+                      clutter_gst_video_sink_do_init);
 
 static void clutter_gst_video_sink_set_texture (ClutterGstVideoSink *sink,
                                                 ClutterTexture      *texture);
+static void clutter_gst_texture_ring_free      (ClutterGstVideoSink *sink);
+static void clutter_gst_video_sink_autotune    (ClutterGstVideoSink *sink,
+                                                GstBuffer           *buffer);
+
+/*
+ * Buffer pool implementation
+ */
+
+static ClutterGstBufferPool *
+clutter_gst_buffer_pool_new (guint max_free)
+{
+  ClutterGstBufferPool *pool;
+
+  pool = g_slice_new0 (ClutterGstBufferPool);
+  pool->ref_count = 1;
+  pool->lock = g_mutex_new ();
+  pool->max_free = max_free;
+
+  return pool;
+}
+
+static ClutterGstBufferPool *
+clutter_gst_buffer_pool_ref (ClutterGstBufferPool *pool)
+{
+  g_atomic_int_inc (&pool->ref_count);
+
+  return pool;
+}
+
+/* has to be called with the pool lock held */
+static void
+clutter_gst_buffer_pool_free_block (ClutterGstBufferPool  *pool,
+                                    ClutterGstBufferBlock *block)
+{
+  pool->n_allocated--;
+  pool->allocated_bytes -= block->size;
+  g_free (block);
+}
+
+/* has to be called with the pool lock held */
+static void
+clutter_gst_buffer_pool_trim (ClutterGstBufferPool *pool,
+                              guint                 max_free)
+{
+  while (pool->n_free > max_free)
+    {
+      ClutterGstBufferBlock *block = pool->free_blocks->data;
+
+      pool->free_blocks = g_slist_delete_link (pool->free_blocks,
+                                               pool->free_blocks);
+      pool->n_free--;
+      clutter_gst_buffer_pool_free_block (pool, block);
+    }
+}
+
+static void
+clutter_gst_buffer_pool_unref (ClutterGstBufferPool *pool)
+{
+  if (!g_atomic_int_dec_and_test (&pool->ref_count))
+    return;
+
+  clutter_gst_buffer_pool_trim (pool, 0);
+  g_mutex_free (pool->lock);
+  g_slice_free (ClutterGstBufferPool, pool);
+}
+
+static void
+clutter_gst_buffer_pool_set_max_free (ClutterGstBufferPool *pool,
+                                      guint                 max_free)
+{
+  g_mutex_lock (pool->lock);
+  pool->max_free = max_free;
+  clutter_gst_buffer_pool_trim (pool, max_free);
+  g_mutex_unlock (pool->lock);
+}
+
+static void
+clutter_gst_buffer_pool_flush (ClutterGstBufferPool *pool)
+{
+  g_mutex_lock (pool->lock);
+  clutter_gst_buffer_pool_trim (pool, 0);
+  g_mutex_unlock (pool->lock);
+}
+
+/* GstBuffer free function, gives the memory back to the pool */
+static void
+clutter_gst_buffer_pool_release (gpointer data)
+{
+  ClutterGstBufferBlock *block = CLUTTER_GST_DATA_BLOCK (data);
+  ClutterGstBufferPool *pool = block->pool;
+
+  g_mutex_lock (pool->lock);
+  if (block->size == pool->block_size && pool->n_free < pool->max_free)
+    {
+      pool->free_blocks = g_slist_prepend (pool->free_blocks, block);
+      pool->n_free++;
+    }
+  else
+    {
+      clutter_gst_buffer_pool_free_block (pool, block);
+    }
+  g_mutex_unlock (pool->lock);
+
+  clutter_gst_buffer_pool_unref (pool);
+}
+
+static GstBuffer *
+clutter_gst_buffer_pool_acquire (ClutterGstBufferPool *pool,
+                                 gsize                 size)
+{
+  ClutterGstBufferBlock *block;
+  GstBuffer *buffer;
+
+  g_mutex_lock (pool->lock);
+
+  /* new frame size, the blocks we have are useless now */
+  if (G_UNLIKELY (size != pool->block_size))
+    {
+      clutter_gst_buffer_pool_trim (pool, 0);
+      pool->block_size = size;
+    }
+
+  if (pool->free_blocks)
+    {
+      block = pool->free_blocks->data;
+      pool->free_blocks = g_slist_delete_link (pool->free_blocks,
+                                               pool->free_blocks);
+      pool->n_free--;
+      pool->hits++;
+    }
+  else
+    {
+      block = g_malloc (CLUTTER_GST_BLOCK_HEADER_SIZE + size);
+      block->pool = pool;
+      block->size = size;
+
+      pool->n_allocated++;
+      pool->allocated_bytes += size;
+      pool->high_water_bytes = MAX (pool->high_water_bytes,
+                                    pool->allocated_bytes);
+      pool->misses++;
+    }
+
+  g_mutex_unlock (pool->lock);
+
+  /* the block keeps the pool alive while it's in use */
+  clutter_gst_buffer_pool_ref (pool);
+
+  buffer = gst_buffer_new ();
+  GST_BUFFER_DATA (buffer) = CLUTTER_GST_BLOCK_DATA (block);
+  GST_BUFFER_MALLOCDATA (buffer) = CLUTTER_GST_BLOCK_DATA (block);
+  GST_BUFFER_SIZE (buffer) = size;
+  GST_BUFFER_FREE_FUNC (buffer) = clutter_gst_buffer_pool_release;
+
+  return buffer;
+}
+
+static GstStructure *
+clutter_gst_buffer_pool_get_stats (ClutterGstBufferPool *pool)
+{
+  GstStructure *stats;
+
+  g_mutex_lock (pool->lock);
+  stats = gst_structure_new ("buffer-pool-stats",
+                             "size", G_TYPE_UINT, pool->max_free,
+                             "free", G_TYPE_UINT, pool->n_free,
+                             "allocated", G_TYPE_UINT, pool->n_allocated,
+                             "block-size", G_TYPE_UINT64,
+                             (guint64) pool->block_size,
+                             "hits", G_TYPE_UINT64, pool->hits,
+                             "misses", G_TYPE_UINT64, pool->misses,
+                             "allocated-bytes", G_TYPE_UINT64,
+                             pool->allocated_bytes,
+                             "high-water-bytes", G_TYPE_UINT64,
+                             pool->high_water_bytes,
+                             NULL);
+  g_mutex_unlock (pool->lock);
+
+  return stats;
+}
 
 /*
  * ClutterGstSource implementation
@@ -253,23 +995,37 @@ clutter_gst_source_new (ClutterGstVideoSink *sink)
   g_source_set_priority (source, CLUTTER_GST_DEFAULT_PRIORITY);
 
   gst_source->sink = sink;
-  gst_source->buffer_lock = g_mutex_new ();
   gst_source->buffer = NULL;
 
   return gst_source;
 }
 
+/* Atomically puts @buffer in the mailbox and returns what was there, the
+ * reference to the buffers is transferred both ways */
+static GstBuffer *
+clutter_gst_source_exchange (ClutterGstSource *gst_source,
+                             GstBuffer        *buffer)
+{
+  GstBuffer *old;
+
+  do
+    old = g_atomic_pointer_get (&gst_source->buffer);
+  while (!g_atomic_pointer_compare_and_exchange ((volatile gpointer *)
+                                                 &gst_source->buffer,
+                                                 old, buffer));
+
+  return old;
+}
+
 static void
 clutter_gst_source_finalize (GSource *source)
 {
   ClutterGstSource *gst_source = (ClutterGstSource *) source;
+  GstBuffer *buffer;
 
-  g_mutex_lock (gst_source->buffer_lock);
-  if (gst_source->buffer)
-    gst_buffer_unref (gst_source->buffer);
-  gst_source->buffer = NULL;
-  g_mutex_unlock (gst_source->buffer_lock);
-  g_mutex_free (gst_source->buffer_lock);
+  buffer = clutter_gst_source_exchange (gst_source, NULL);
+  if (buffer)
+    gst_buffer_unref (buffer);
 }
 
 static void
@@ -277,12 +1033,17 @@ clutter_gst_source_push (ClutterGstSource *gst_source,
                          GstBuffer        *buffer)
 {
   ClutterGstVideoSinkPrivate *priv = gst_source->sink->priv;
+  GstBuffer *old;
 
-  g_mutex_lock (gst_source->buffer_lock);
-  if (gst_source->buffer)
-    gst_buffer_unref (gst_source->buffer);
-  gst_source->buffer = gst_buffer_ref (buffer);
-  g_mutex_unlock (gst_source->buffer_lock);
+  /* a frame that has not been picked up by the clutter thread yet is
+   * superseded by the new one */
+  old = clutter_gst_source_exchange (gst_source, gst_buffer_ref (buffer));
+  if (old)
+    {
+      g_atomic_int_inc (&priv->frames_superseded);
+      g_atomic_int_inc (&priv->dropped_frames);
+      gst_buffer_unref (old);
+    }
 
   g_main_context_wakeup (priv->clutter_main_context);
 }
@@ -295,7 +1056,7 @@ clutter_gst_source_prepare (GSource *source,
 
   *timeout = -1;
 
-  return gst_source->buffer != NULL;
+  return g_atomic_pointer_get (&gst_source->buffer) != NULL;
 }
 
 static gboolean
@@ -303,122 +1064,898 @@ clutter_gst_source_check (GSource *source)
 {
   ClutterGstSource *gst_source = (ClutterGstSource *) source;
 
-  return gst_source->buffer != NULL;
+  return g_atomic_pointer_get (&gst_source->buffer) != NULL;
 }
 
-static gboolean
-clutter_gst_source_dispatch (GSource     *source,
-                             GSourceFunc  callback,
-                             gpointer     user_data)
+/* If we happen to use a ClutterGstVideoTexture, now is to good time to
+ * instruct it about the pixel aspect ratio so we can have a correct
+ * natural width/height. The packed 4:2:2 formats are uploaded in textures
+ * half as wide as the frames, which we compensate for here */
+static void
+clutter_gst_video_sink_set_par (ClutterGstVideoSink *sink,
+                                ClutterTexture      *texture)
 {
-  ClutterGstSource *gst_source = (ClutterGstSource *) source;
-  ClutterGstVideoSinkPrivate *priv = gst_source->sink->priv;
-  GstBuffer *buffer;
+  ClutterGstVideoSinkPrivate *priv = sink->priv;
+  gint par_n = priv->par_n;
 
-  /* The initialization / free functions of the renderers have to be called in
-   * the clutter thread (OpenGL context) */
-  if (G_UNLIKELY (priv->renderer_state == CLUTTER_GST_RENDERER_NEED_GC))
-    {
-      priv->renderer->deinit (gst_source->sink);
-      priv->renderer_state = CLUTTER_GST_RENDERER_STOPPED;
-    }
-  if (G_UNLIKELY (priv->renderer_state == CLUTTER_GST_RENDERER_STOPPED))
-    {
-      priv->renderer->init (gst_source->sink);
-      priv->renderer_state = CLUTTER_GST_RENDERER_RUNNING;
-    }
+  if (!CLUTTER_GST_IS_VIDEO_TEXTURE (texture))
+    return;
 
-  g_mutex_lock (gst_source->buffer_lock);
-  buffer = gst_source->buffer;
-  gst_source->buffer = NULL;
-  g_mutex_unlock (gst_source->buffer_lock);
+  if (priv->format == CLUTTER_GST_YUY2 || priv->format == CLUTTER_GST_UYVY)
+    par_n *= 2;
 
-  if (buffer)
-    {
-      priv->renderer->upload (gst_source->sink, buffer);
-      gst_buffer_unref (buffer);
-    }
+  _clutter_gst_video_texture_set_par (CLUTTER_GST_VIDEO_TEXTURE (texture),
+                                      par_n, priv->par_d);
+}
 
-  return TRUE;
+static void
+clutter_gst_frame_timing_init (ClutterGstFrameTiming *timing)
+{
+  timing->timestamp = GST_CLOCK_TIME_NONE;
+  timing->running_time = GST_CLOCK_TIME_NONE;
+  timing->render = GST_CLOCK_TIME_NONE;
+  timing->dispatch = GST_CLOCK_TIME_NONE;
+  timing->upload = GST_CLOCK_TIME_NONE;
+  timing->paint = GST_CLOCK_TIME_NONE;
 }
 
-static GSourceFuncs gst_source_funcs = {
-  clutter_gst_source_prepare,
-  clutter_gst_source_check,
-  clutter_gst_source_dispatch,
-  clutter_gst_source_finalize
-};
+/* in microseconds, -1 when one of the two is unknown */
+#define TIMING_DIFF(end,start)                                          \
+  ((GST_CLOCK_TIME_IS_VALID (end) && GST_CLOCK_TIME_IS_VALID (start)) ? \
+   (gint64) ((end) - (start)) / 1000 : (gint64) -1)
 
+/* Called from the clutter thread the first time a frame is painted */
 static void
-clutter_gst_video_sink_set_priority (ClutterGstVideoSink *sink,
-                                     int                  priority)
+clutter_gst_video_sink_trace_paint (ClutterGstVideoSink *sink)
 {
   ClutterGstVideoSinkPrivate *priv = sink->priv;
+  ClutterGstFrameTiming *timing = &priv->timing;
+
+  timing->paint = gst_util_get_timestamp ();
+
+  g_mutex_lock (priv->stats_lock);
+  priv->timing_ring[priv->timing_ring_index] = *timing;
+  priv->timing_ring_index =
+    (priv->timing_ring_index + 1) % CLUTTER_GST_TIMING_RING_SIZE;
+  priv->n_timings = MIN (priv->n_timings + 1, CLUTTER_GST_TIMING_RING_SIZE);
+  g_mutex_unlock (priv->stats_lock);
+
+  CLUTTER_GST_TIMESTAMP (LATENCY, "frame %" GST_TIME_FORMAT " (running time "
+                         "%" GST_TIME_FORMAT ") painted, render to dispatch "
+                         "%" G_GINT64_FORMAT "us, dispatch to upload "
+                         "%" G_GINT64_FORMAT "us, upload to paint "
+                         "%" G_GINT64_FORMAT "us, total %" G_GINT64_FORMAT "us",
+                         GST_TIME_ARGS (timing->timestamp),
+                         GST_TIME_ARGS (timing->running_time),
+                         TIMING_DIFF (timing->dispatch, timing->render),
+                         TIMING_DIFF (timing->upload, timing->dispatch),
+                         TIMING_DIFF (timing->paint, timing->upload),
+                         TIMING_DIFF (timing->paint, timing->render));
+
+  g_signal_emit (sink, video_sink_signals[FRAME_LATENCY], 0, timing);
+}
 
-  GST_INFO ("GSource priority: %d", priority);
+/* Updates the statistics after a frame of @size bytes has been uploaded,
+ * the upload having started at @start on the stats timer */
+static void
+clutter_gst_video_sink_account_upload (ClutterGstVideoSink *sink,
+                                       guint                size,
+                                       gdouble              start)
+{
+  ClutterGstVideoSinkPrivate *priv = sink->priv;
+  gdouble now, elapsed;
+  guint bucket, bound;
 
-  g_source_set_priority ((GSource *) priv->source, priority);
-}
+  now = g_timer_elapsed (priv->stats_timer, NULL);
+  elapsed = now - start;
 
-/*
- * Small helpers
- */
+  bucket = 0;
+  bound = CLUTTER_GST_UPLOAD_BUCKET_0_US;
+  while (bucket < CLUTTER_GST_N_UPLOAD_BUCKETS - 1 && elapsed * 1e6 >= bound)
+    {
+      bucket++;
+      bound *= 2;
+    }
+
+  g_atomic_int_inc (&priv->frames_uploaded);
+  priv->frame_painted = FALSE;
+
+  g_mutex_lock (priv->stats_lock);
+
+  priv->upload_histogram[bucket]++;
+  priv->upload_time_total += elapsed;
+  priv->upload_time_max = MAX (priv->upload_time_max, elapsed);
+  priv->bytes_uploaded += size;
+
+  /* the rate is measured over windows of about a second */
+  priv->window_bytes += size;
+  if (now - priv->window_start >= 1.0)
+    {
+      priv->bytes_per_second = priv->window_bytes /
+                               (now - priv->window_start);
+      priv->window_bytes = 0;
+      priv->window_start = now;
+    }
+
+  g_mutex_unlock (priv->stats_lock);
+}
 
-#ifdef CLUTTER_COGL_HAS_GL
 static void
-_string_array_to_char_array (char	*dst,
-                             const char *src[])
+clutter_gst_video_sink_reset_stats (ClutterGstVideoSink *sink)
 {
-  int i, n;
+  ClutterGstVideoSinkPrivate *priv = sink->priv;
 
-  for (i = 0; src[i]; i++) {
-      n = strlen (src[i]);
-      memcpy (dst, src[i], n);
-      dst += n;
-  }
-  *dst = '\0';
+  g_atomic_int_set (&priv->frames_received, 0);
+  g_atomic_int_set (&priv->frames_superseded, 0);
+  g_atomic_int_set (&priv->dropped_frames, 0);
+  g_atomic_int_set (&priv->frames_uploaded, 0);
+  g_atomic_int_set (&priv->frames_painted, 0);
+
+  g_mutex_lock (priv->stats_lock);
+  memset (priv->upload_histogram, 0, sizeof (priv->upload_histogram));
+  priv->upload_time_total = priv->upload_time_max = 0;
+  priv->bytes_uploaded = priv->window_bytes = 0;
+  priv->bytes_per_second = 0;
+  priv->window_start = g_timer_elapsed (priv->stats_timer, NULL);
+  priv->timing_ring_index = priv->n_timings = 0;
+  g_mutex_unlock (priv->stats_lock);
 }
-#endif
 
-#if defined (HAVE_COGL_1_8) && !defined (HAVE_CLUTTER_OSX)
-static gint
-get_n_fragment_texture_units (void)
+/* Whether @buffer has the layout the planes have been set up for. A frame
+ * waiting for the clutter thread can have been rendered before set_caps()
+ * changed that layout, uploading it would read past its end or show it
+ * garbled */
+static gboolean
+clutter_gst_video_sink_buffer_fits (ClutterGstVideoSink *sink,
+                                    GstBuffer           *buffer)
 {
-  ClutterBackend *backend;
-  CoglContext *context;
-  CoglDisplay *display;
-  CoglRenderer *renderer;
-  gint n;
+  ClutterGstVideoSinkPrivate *priv = sink->priv;
+  GstStructure *structure;
+  gint width, height;
 
-  backend = clutter_get_default_backend ();
-  context = clutter_backend_get_cogl_context (backend);
-  display = cogl_context_get_display (context);
-  renderer = cogl_display_get_renderer (display);
+  if (GST_BUFFER_SIZE (buffer) < priv->frame_size)
+    return FALSE;
 
-  n = cogl_renderer_get_n_fragment_texture_units (renderer);
+  if (GST_BUFFER_CAPS (buffer) == NULL)
+    return TRUE;
 
-  return n;
-}
-#else
-static gint
-get_n_fragment_texture_units (void)
-{
-  gint n_texture_units;
+  structure = gst_caps_get_structure (GST_BUFFER_CAPS (buffer), 0);
+  if (!gst_structure_get_int (structure, "width", &width) ||
+      !gst_structure_get_int (structure, "height", &height))
+    return TRUE;
 
-  glGetIntegerv (GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS, &n_texture_units);
-  return n_texture_units;
+  return width == priv->width && height == priv->height;
 }
+
+#ifdef CLUTTER_GST_HAVE_PBO_UPLOADS
+static void clutter_gst_texture_ring_prepare_stage (ClutterGstVideoSink *sink);
 #endif
 
-static CoglHandle
-_create_cogl_program (const char *source)
+/* Uploads @buffer with the current renderer and releases it. Has to be
+ * called from the clutter thread */
+static void
+clutter_gst_video_sink_upload (ClutterGstVideoSink *sink,
+                               GstBuffer           *buffer)
 {
-  CoglHandle shader;
-  CoglHandle program;
+  ClutterGstVideoSinkPrivate *priv = sink->priv;
+  gdouble start;
 
-  /* Create shader through Cogl - necessary as we need to be able to set
-   * integer uniform variables for multi-texturing.
-   */
+  if (G_UNLIKELY (!clutter_gst_video_sink_buffer_fits (sink, buffer)))
+    {
+      GST_DEBUG_OBJECT (sink, "dropping a %u bytes frame rendered before the "
+                        "caps changed", GST_BUFFER_SIZE (buffer));
+      g_atomic_int_inc (&priv->dropped_frames);
+      gst_buffer_unref (buffer);
+      return;
+    }
+
+  /* The initialization / free functions of the renderers have to be called in
+   * the clutter thread (OpenGL context) */
+  if (G_UNLIKELY (priv->renderer_state == CLUTTER_GST_RENDERER_NEED_GC))
+    {
+      priv->renderer->deinit (sink);
+      clutter_gst_texture_ring_free (sink);
+      priv->renderer_state = CLUTTER_GST_RENDERER_STOPPED;
+    }
+  if (G_UNLIKELY (priv->renderer_state == CLUTTER_GST_RENDERER_STOPPED))
+    {
+      if (G_UNLIKELY (g_atomic_int_get (&priv->registry->autotune) &&
+                      priv->forced_renderer == NULL))
+        clutter_gst_video_sink_autotune (sink, buffer);
+
+      priv->renderer->init (sink);
+      priv->renderer_state = CLUTTER_GST_RENDERER_RUNNING;
+    }
+
+  if (G_UNLIKELY (g_atomic_int_get (&priv->textures_par_dirty)))
+    {
+      GSList *l;
+
+      g_atomic_int_set (&priv->textures_par_dirty, FALSE);
+      for (l = priv->textures; l; l = l->next)
+        clutter_gst_video_sink_set_par (sink, l->data);
+    }
+
+  start = g_timer_elapsed (priv->stats_timer, NULL);
+  priv->renderer->upload (sink, buffer);
+  clutter_gst_video_sink_account_upload (sink, GST_BUFFER_SIZE (buffer),
+                                         start);
+  gst_buffer_unref (buffer);
+
+#ifdef CLUTTER_GST_HAVE_PBO_UPLOADS
+  clutter_gst_texture_ring_prepare_stage (sink);
+#endif
+
+  if (G_UNLIKELY (priv->trace_latency))
+    {
+      priv->timing = priv->next_timing;
+      priv->timing.upload = gst_util_get_timestamp ();
+    }
+}
+
+/* Whether any part of @actor would end up on the screen if the stage was
+ * painted now */
+static gboolean
+clutter_gst_actor_is_visible (ClutterActor *actor)
+{
+  ClutterActor *stage;
+  ClutterActorBox box;
+  gfloat stage_width, stage_height;
+
+  if (!CLUTTER_ACTOR_IS_MAPPED (actor))
+    return FALSE;
+
+  if (clutter_actor_get_paint_opacity (actor) == 0)
+    return FALSE;
+
+  stage = clutter_actor_get_stage (actor);
+  if (stage == NULL)
+    return FALSE;
+
+  /* the paint box is in stage coordinates. If clutter can't give us one we
+   * can only assume the texture is on screen */
+  if (!clutter_actor_get_paint_box (actor, &box))
+    return TRUE;
+
+  clutter_actor_get_size (stage, &stage_width, &stage_height);
+
+  return box.x2 > 0 && box.y2 > 0 &&
+         box.x1 < stage_width && box.y1 < stage_height;
+}
+
+/* Whether any of the textures showing the frames can be seen */
+static gboolean
+clutter_gst_video_sink_texture_is_visible (ClutterGstVideoSink *sink)
+{
+  ClutterGstVideoSinkPrivate *priv = sink->priv;
+  GSList *l;
+
+  /* without a texture we have no way to know, keep uploading */
+  if (priv->texture == NULL)
+    return TRUE;
+
+  if (clutter_gst_actor_is_visible (CLUTTER_ACTOR (priv->texture)))
+    return TRUE;
+
+  for (l = priv->textures; l; l = l->next)
+    if (clutter_gst_actor_is_visible (CLUTTER_ACTOR (l->data)))
+      return TRUE;
+
+  return FALSE;
+}
+
+static void
+clutter_gst_video_sink_queue_redraw (ClutterGstVideoSink *sink)
+{
+  ClutterGstVideoSinkPrivate *priv = sink->priv;
+  GSList *l;
+
+  if (priv->texture)
+    clutter_actor_queue_redraw (CLUTTER_ACTOR (priv->texture));
+
+  for (l = priv->textures; l; l = l->next)
+    clutter_actor_queue_redraw (CLUTTER_ACTOR (l->data));
+}
+
+/* Has to be called from the clutter thread */
+static void
+clutter_gst_video_sink_update_visibility (ClutterGstVideoSink *sink)
+{
+  ClutterGstVideoSinkPrivate *priv = sink->priv;
+  GstBaseSink *bsink = GST_BASE_SINK (sink);
+  gboolean hidden;
+
+  hidden = !priv->painted_since_check &&
+           !clutter_gst_video_sink_texture_is_visible (sink);
+  if (hidden == g_atomic_int_get (&priv->hidden))
+    return;
+
+  if (hidden)
+    {
+      GST_DEBUG_OBJECT (sink, "texture hidden, stop uploading frames");
+
+      /* the QoS events of the base sink would tell upstream we are on time
+       * and cancel the ones we send while hidden */
+      priv->qos_enabled = gst_base_sink_is_qos_enabled (bsink);
+      gst_base_sink_set_qos_enabled (bsink, FALSE);
+      g_atomic_int_set (&priv->hidden, TRUE);
+    }
+  else
+    {
+      GST_DEBUG_OBJECT (sink, "texture visible again, resume uploading");
+
+      g_atomic_int_set (&priv->hidden, FALSE);
+      gst_base_sink_set_qos_enabled (bsink, priv->qos_enabled);
+
+      /* the last frame received while hidden is uploaded right before the
+       * next paint */
+      if (priv->pending_buffer)
+        clutter_gst_video_sink_queue_redraw (sink);
+    }
+}
+
+static void
+on_texture_visibility_changed (GObject    *object,
+                               GParamSpec *pspec,
+                               gpointer    user_data)
+{
+  clutter_gst_video_sink_update_visibility (CLUTTER_GST_VIDEO_SINK (user_data));
+}
+
+static gboolean
+clutter_gst_source_dispatch (GSource     *source,
+                             GSourceFunc  callback,
+                             gpointer     user_data)
+{
+  ClutterGstSource *gst_source = (ClutterGstSource *) source;
+  ClutterGstVideoSink *sink = gst_source->sink;
+  ClutterGstVideoSinkPrivate *priv = sink->priv;
+  GstBuffer *buffer;
+
+  if (G_UNLIKELY (priv->trace_latency))
+    {
+      /* pick the timing of the buffer along with it */
+      g_mutex_lock (priv->trace_lock);
+      buffer = clutter_gst_source_exchange (gst_source, NULL);
+      if (buffer && buffer == priv->render_buffer)
+        priv->next_timing = priv->render_timing;
+      else
+        clutter_gst_frame_timing_init (&priv->next_timing);
+      priv->render_buffer = NULL;
+      g_mutex_unlock (priv->trace_lock);
+
+      priv->next_timing.dispatch = gst_util_get_timestamp ();
+    }
+  else
+    buffer = clutter_gst_source_exchange (gst_source, NULL);
+
+  if (buffer == NULL)
+    return TRUE;
+
+  if (priv->upload_on_paint || g_atomic_int_get (&priv->hidden))
+    {
+      /* only keep the frame around, it will be uploaded right before the
+       * next paint unless a newer frame shows up first. While the texture
+       * is hidden there is no paint to wait for, only the latest frame is
+       * kept so that it can be shown as soon as the texture is visible */
+      if (priv->pending_buffer)
+        {
+          g_atomic_int_inc (&priv->dropped_frames);
+          gst_buffer_unref (priv->pending_buffer);
+
+          GST_LOG_OBJECT (sink, "frame superseded before paint, %d dropped",
+                          g_atomic_int_get (&priv->dropped_frames));
+        }
+      priv->pending_buffer = buffer;
+      priv->pending_timing = priv->next_timing;
+
+      if (!g_atomic_int_get (&priv->hidden))
+        clutter_gst_video_sink_queue_redraw (sink);
+    }
+  else
+    {
+      clutter_gst_video_sink_upload (sink, buffer);
+    }
+
+  return TRUE;
+}
+
+/* Called by clutter before painting the stages */
+static gboolean
+clutter_gst_video_sink_repaint_func (gpointer data)
+{
+  ClutterGstVideoSink *sink = CLUTTER_GST_VIDEO_SINK (data);
+  ClutterGstVideoSinkPrivate *priv = sink->priv;
+  GstBuffer *buffer;
+
+  /* the texture may have been moved out of the stage or one of its parents
+   * hidden or faded out since the last frame, none of which is notified on
+   * the texture itself. A paint of the texture since the last check
+   * (maybe by a clone showing it) keeps it visible for this frame */
+  clutter_gst_video_sink_update_visibility (sink);
+  priv->painted_since_check = FALSE;
+
+  if (priv->pending_buffer && !g_atomic_int_get (&priv->hidden))
+    {
+      buffer = priv->pending_buffer;
+      priv->pending_buffer = NULL;
+      priv->next_timing = priv->pending_timing;
+
+      clutter_gst_video_sink_upload (sink, buffer);
+    }
+
+  return TRUE;
+}
+
+static GSourceFuncs gst_source_funcs = {
+  clutter_gst_source_prepare,
+  clutter_gst_source_check,
+  clutter_gst_source_dispatch,
+  clutter_gst_source_finalize
+};
+
+static void
+clutter_gst_video_sink_set_priority (ClutterGstVideoSink *sink,
+                                     int                  priority)
+{
+  ClutterGstVideoSinkPrivate *priv = sink->priv;
+
+  GST_INFO ("GSource priority: %d", priority);
+
+  g_source_set_priority ((GSource *) priv->source, priority);
+}
+
+/*
+ * Small helpers
+ */
+
+#ifdef CLUTTER_COGL_HAS_GL
+static void
+_string_array_to_char_array (char	*dst,
+                             const char *src[])
+{
+  int i, n;
+
+  for (i = 0; src[i]; i++) {
+      n = strlen (src[i]);
+      memcpy (dst, src[i], n);
+      dst += n;
+  }
+  *dst = '\0';
+}
+#endif
+
+#if defined (HAVE_COGL_1_8) && !defined (HAVE_CLUTTER_OSX)
+static gint
+get_n_fragment_texture_units (void)
+{
+  ClutterBackend *backend;
+  CoglContext *context;
+  CoglDisplay *display;
+  CoglRenderer *renderer;
+  gint n;
+
+  backend = clutter_get_default_backend ();
+  context = clutter_backend_get_cogl_context (backend);
+  display = cogl_context_get_display (context);
+  renderer = cogl_display_get_renderer (display);
+
+  n = cogl_renderer_get_n_fragment_texture_units (renderer);
+
+  return n;
+}
+#else
+static gint
+get_n_fragment_texture_units (void)
+{
+  gint n_texture_units;
+
+  glGetIntegerv (GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS, &n_texture_units);
+  return n_texture_units;
+}
+#endif
+
+/*
+ * Texture ring
+ */
+
+static gboolean clutter_gst_texture_ring_unstage (ClutterGstVideoSink *sink,
+                                                  GstBuffer           *buffer);
+
+static void
+clutter_gst_texture_ring_free (ClutterGstVideoSink *sink)
+{
+  ClutterGstVideoSinkPrivate *priv = sink->priv;
+  guint i, j;
+
+  clutter_gst_texture_ring_unstage (sink, NULL);
+
+  for (i = 0; i < CLUTTER_GST_TEXTURE_RING_SIZE; i++)
+    {
+      if (priv->ring_material[i])
+        {
+          cogl_object_unref (priv->ring_material[i]);
+          priv->ring_material[i] = NULL;
+        }
+
+      if (priv->ring_pbo[i] != COGL_INVALID_HANDLE)
+        {
+          cogl_handle_unref (priv->ring_pbo[i]);
+          priv->ring_pbo[i] = COGL_INVALID_HANDLE;
+          priv->ring_pbo_size[i] = 0;
+        }
+
+      for (j = 0; j < CLUTTER_GST_MAX_PLANES; j++)
+        {
+          if (priv->ring[i][j] != COGL_INVALID_HANDLE)
+            {
+              cogl_handle_unref (priv->ring[i][j]);
+              priv->ring[i][j] = COGL_INVALID_HANDLE;
+            }
+        }
+    }
+
+  priv->ring_index = 0;
+  priv->ring_format = CLUTTER_GST_NOFORMAT;
+  priv->ring_width = priv->ring_height = 0;
+}
+
+static gboolean
+clutter_gst_texture_ring_can_use_pbo (ClutterGstVideoSink *sink)
+{
+  ClutterGstVideoSinkPrivate *priv = sink->priv;
+
+  if (!priv->use_pbo)
+    return FALSE;
+
+  if (G_UNLIKELY (!priv->pbo_checked))
+    {
+      /* without a way to update the textures of the ring from a pixel
+       * buffer, new textures would have to be created for every frame */
+#ifdef CLUTTER_GST_HAVE_PBO_UPLOADS
+      priv->pbo_available = cogl_features_available (COGL_FEATURE_PBOS);
+#else
+      priv->pbo_available = FALSE;
+#endif
+      priv->pbo_checked = TRUE;
+
+      if (!priv->pbo_available)
+        GST_WARNING_OBJECT (sink, "pixel buffers are not supported, "
+                            "uploading the frames directly");
+    }
+
+  return priv->pbo_available;
+}
+
+/* Called from the streaming thread before handing @buffer to the clutter
+ * thread. Copies the frame into the pixel buffer the clutter thread has
+ * mapped for the next slot of the ring, if any, while it is busy painting.
+ * The textures of the slot are then updated from GPU memory */
+static void
+clutter_gst_video_sink_stage (ClutterGstVideoSink *sink,
+                              GstBuffer           *buffer)
+{
+  ClutterGstVideoSinkPrivate *priv = sink->priv;
+  guint8 *data;
+  gsize size;
+
+  g_mutex_lock (priv->stage_lock);
+
+  if (priv->stage_state != CLUTTER_GST_STAGE_READY ||
+      GST_BUFFER_SIZE (buffer) < priv->stage_size)
+    {
+      g_mutex_unlock (priv->stage_lock);
+      return;
+    }
+
+  priv->stage_state = CLUTTER_GST_STAGE_COPYING;
+  data = priv->stage_data;
+  size = priv->stage_size;
+
+  g_mutex_unlock (priv->stage_lock);
+
+  memcpy (data, GST_BUFFER_DATA (buffer), size);
+
+  g_mutex_lock (priv->stage_lock);
+  priv->stage_buffer = gst_buffer_ref (buffer);
+  priv->stage_state = CLUTTER_GST_STAGE_STAGED;
+  g_cond_broadcast (priv->stage_cond);
+  g_mutex_unlock (priv->stage_lock);
+}
+
+/* Takes the pixel buffer mapped for the streaming thread back, waiting for
+ * the copy in progress if any, and unmaps it. Returns whether @buffer is
+ * the frame copied into it. Has to be called from the clutter thread */
+static gboolean
+clutter_gst_texture_ring_unstage (ClutterGstVideoSink *sink,
+                                  GstBuffer           *buffer)
+{
+  ClutterGstVideoSinkPrivate *priv = sink->priv;
+  GstBuffer *staged_buffer;
+  gboolean staged;
+
+  g_mutex_lock (priv->stage_lock);
+
+  while (priv->stage_state == CLUTTER_GST_STAGE_COPYING)
+    g_cond_wait (priv->stage_cond, priv->stage_lock);
+
+  if (priv->stage_state == CLUTTER_GST_STAGE_NONE)
+    {
+      g_mutex_unlock (priv->stage_lock);
+      return FALSE;
+    }
+
+  staged = buffer && priv->stage_buffer == buffer;
+  staged_buffer = priv->stage_buffer;
+
+  priv->stage_state = CLUTTER_GST_STAGE_NONE;
+  priv->stage_data = NULL;
+  priv->stage_buffer = NULL;
+
+  g_mutex_unlock (priv->stage_lock);
+
+  if (staged_buffer)
+    gst_buffer_unref (staged_buffer);
+
+  /* stage_slot is only changed by the clutter thread */
+#ifdef CLUTTER_GST_HAVE_PBO_UPLOADS
+  cogl_buffer_unmap (COGL_BUFFER (priv->ring_pbo[priv->stage_slot]));
+#endif
+
+  return staged;
+}
+
+#ifdef CLUTTER_GST_HAVE_PBO_UPLOADS
+/* Whether the frame staged by the streaming thread will never reach the
+ * clutter thread, having been superseded by the frame being uploaded */
+static gboolean
+clutter_gst_texture_ring_stage_is_stale (ClutterGstVideoSink *sink,
+                                         GstBuffer           *staged_buffer)
+{
+  ClutterGstVideoSinkPrivate *priv = sink->priv;
+
+  return staged_buffer != priv->pending_buffer &&
+         staged_buffer != g_atomic_pointer_get (&priv->source->buffer);
+}
+
+/* Picks the pixel buffer of the current slot up if the streaming thread
+ * has copied @buffer into it, and drops the frames it copied that were
+ * superseded before being uploaded */
+static void
+clutter_gst_texture_ring_take_stage (ClutterGstVideoSink *sink,
+                                     GstBuffer           *buffer)
+{
+  ClutterGstVideoSinkPrivate *priv = sink->priv;
+  gboolean take, ours;
+
+  g_mutex_lock (priv->stage_lock);
+
+  ours = priv->stage_state == CLUTTER_GST_STAGE_STAGED &&
+         priv->stage_buffer == buffer &&
+         priv->stage_slot == priv->ring_index &&
+         priv->stage_size >= priv->frame_size;
+  take = ours ||
+         (priv->stage_state == CLUTTER_GST_STAGE_STAGED &&
+          clutter_gst_texture_ring_stage_is_stale (sink, priv->stage_buffer));
+
+  g_mutex_unlock (priv->stage_lock);
+
+  if (take)
+    priv->ring_pbo_staged =
+      clutter_gst_texture_ring_unstage (sink, buffer) && ours;
+}
+
+/* Maps the pixel buffer of the slot following the current one for the
+ * streaming thread to copy the next frame into. A slot without textures
+ * yet is filled straight from the frame instead. Has to be called from the
+ * clutter thread once the current frame is uploaded */
+static void
+clutter_gst_texture_ring_prepare_stage (ClutterGstVideoSink *sink)
+{
+  ClutterGstVideoSinkPrivate *priv = sink->priv;
+  guint slot = (priv->ring_index + 1) % CLUTTER_GST_TEXTURE_RING_SIZE;
+  CoglHandle *pbo = &priv->ring_pbo[slot];
+  ClutterGstStageState state;
+  guint8 *data;
+
+  if (!clutter_gst_texture_ring_can_use_pbo (sink) ||
+      priv->ring[slot][0] == COGL_INVALID_HANDLE)
+    return;
+
+  g_mutex_lock (priv->stage_lock);
+  state = priv->stage_state;
+  g_mutex_unlock (priv->stage_lock);
+
+  /* a frame is on its way */
+  if (state == CLUTTER_GST_STAGE_COPYING || state == CLUTTER_GST_STAGE_STAGED)
+    return;
+
+  if (state == CLUTTER_GST_STAGE_READY)
+    {
+      if (priv->stage_slot == slot)
+        return;
+
+      clutter_gst_texture_ring_unstage (sink, NULL);
+    }
+
+  if (*pbo == COGL_INVALID_HANDLE ||
+      priv->ring_pbo_size[slot] < priv->frame_size)
+    {
+      if (*pbo != COGL_INVALID_HANDLE)
+        cogl_handle_unref (*pbo);
+
+      *pbo = cogl_pixel_buffer_new (priv->frame_size);
+      priv->ring_pbo_size[slot] = priv->frame_size;
+      if (*pbo != COGL_INVALID_HANDLE)
+        cogl_buffer_set_update_hint (COGL_BUFFER (*pbo),
+                                     COGL_BUFFER_UPDATE_HINT_STREAM);
+    }
+
+  data = NULL;
+  if (*pbo != COGL_INVALID_HANDLE)
+    data = cogl_buffer_map (COGL_BUFFER (*pbo),
+                            COGL_BUFFER_ACCESS_WRITE,
+                            COGL_BUFFER_MAP_HINT_DISCARD);
+
+  /* don't try again for every frame */
+  if (G_UNLIKELY (data == NULL))
+    {
+      GST_WARNING_OBJECT (sink, "could not map a pixel buffer, uploading "
+                          "the frames directly");
+      priv->pbo_available = FALSE;
+      return;
+    }
+
+  g_mutex_lock (priv->stage_lock);
+  priv->stage_data = data;
+  priv->stage_size = priv->frame_size;
+  priv->stage_slot = slot;
+  priv->stage_state = CLUTTER_GST_STAGE_READY;
+  g_mutex_unlock (priv->stage_lock);
+}
+#endif
+
+/* Selects the next set of textures of the ring, dropping all the textures if
+ * the frames we are about to upload don't have the same geometry or format
+ * as the ones the ring was created for. When streaming through pixel
+ * buffers, picks up the pixel buffer of the new slot if the streaming
+ * thread has copied the frame into it */
+static void
+clutter_gst_texture_ring_advance (ClutterGstVideoSink *sink,
+                                  GstBuffer           *buffer)
+{
+  ClutterGstVideoSinkPrivate *priv = sink->priv;
+
+  if (G_UNLIKELY (priv->ring_format != priv->format ||
+                  priv->ring_bgr != priv->bgr ||
+                  priv->ring_width != priv->width ||
+                  priv->ring_height != priv->height))
+    {
+      GST_DEBUG_OBJECT (sink, "(re)allocating the texture ring for %dx%d "
+                        "frames", priv->width, priv->height);
+
+      clutter_gst_texture_ring_free (sink);
+
+      priv->ring_format = priv->format;
+      priv->ring_bgr = priv->bgr;
+      priv->ring_width = priv->width;
+      priv->ring_height = priv->height;
+    }
+  else
+    {
+      priv->ring_index = (priv->ring_index + 1) % CLUTTER_GST_TEXTURE_RING_SIZE;
+    }
+
+  priv->ring_pbo_staged = FALSE;
+
+#ifdef CLUTTER_GST_HAVE_PBO_UPLOADS
+  clutter_gst_texture_ring_take_stage (sink, buffer);
+#else
+  clutter_gst_texture_ring_can_use_pbo (sink);
+#endif
+}
+
+/* Uploads a plane of the frame into the current texture of the ring for
+ * that plane, honouring the row stride and offset of the plane so the frame
+ * never has to be repacked (Cogl gives the row stride to GL as the row
+ * length to unpack). The texture is created the first time and updated in
+ * place after that, from the pixel buffer when the frame has been staged in
+ * one. The returned texture is owned by the ring. */
+static CoglHandle
+clutter_gst_texture_ring_upload_layout (ClutterGstVideoSink   *sink,
+                                        guint                  plane,
+                                        const ClutterGstPlane *layout,
+                                        CoglPixelFormat        format,
+                                        GstBuffer             *buffer)
+{
+  ClutterGstVideoSinkPrivate *priv = sink->priv;
+  CoglHandle *tex = &priv->ring[priv->ring_index][plane];
+
+#ifdef CLUTTER_GST_HAVE_PBO_UPLOADS
+  if (priv->ring_pbo_staged && *tex != COGL_INVALID_HANDLE)
+    {
+      CoglBitmap *bitmap;
+      gboolean updated;
+
+      bitmap = cogl_bitmap_new_from_buffer (priv->ring_pbo[priv->ring_index],
+                                            format,
+                                            layout->width,
+                                            layout->height,
+                                            layout->rowstride,
+                                            layout->offset);
+      updated = cogl_texture_set_region_from_bitmap (*tex,
+                                                     0, 0,
+                                                     0, 0,
+                                                     layout->width,
+                                                     layout->height,
+                                                     bitmap);
+      cogl_object_unref (bitmap);
+
+      if (updated)
+        return *tex;
+    }
+#endif
+
+  if (*tex == COGL_INVALID_HANDLE)
+    {
+      *tex = cogl_texture_new_from_data (layout->width,
+                                         layout->height,
+                                         CLUTTER_GST_TEXTURE_FLAGS,
+                                         format,
+                                         format,
+                                         layout->rowstride,
+                                         GST_BUFFER_DATA (buffer) +
+                                         layout->offset);
+    }
+  else
+    {
+      cogl_texture_set_region (*tex,
+                               0, 0,
+                               0, 0,
+                               layout->width, layout->height,
+                               layout->width, layout->height,
+                               format,
+                               layout->rowstride,
+                               GST_BUFFER_DATA (buffer) + layout->offset);
+    }
+
+  return *tex;
+}
+
+static CoglHandle
+clutter_gst_texture_ring_upload (ClutterGstVideoSink *sink,
+                                 guint                plane,
+                                 CoglPixelFormat      format,
+                                 GstBuffer           *buffer)
+{
+  return clutter_gst_texture_ring_upload_layout (sink, plane,
+                                                 &sink->priv->planes[plane],
+                                                 format, buffer);
+}
+
+static CoglHandle
+_create_cogl_program (const char *source,
+                      int         n_samplers)
+{
+  /* the layer each sampler reads from, the NV12 programs read both
+   * chroma planes from the second one */
+  static const struct {
+    const char *name;
+    int         layer;
+  } samplers[] = {
+    { "ytex",    0 },
+    { "utex",    1 },
+    { "uvtex",   1 },
+    { "vtex",    2 },
+    { "prevtex", 3 }
+  };
+  CoglHandle shader;
+  CoglHandle program;
+  int i;
+
+  /* Create shader through Cogl - necessary as we need to be able to set
+   * integer uniform variables for multi-texturing.
+   */
   shader = cogl_create_shader (COGL_SHADER_TYPE_FRAGMENT);
   cogl_shader_source (shader, source);
   cogl_shader_compile (shader);
@@ -429,87 +1966,451 @@ _create_cogl_program (const char *source)
 
   cogl_handle_unref (shader);
 
+  if (n_samplers > 0)
+    {
+      cogl_program_use (program);
+
+      for (i = 0; i < G_N_ELEMENTS (samplers); i++)
+        {
+          int location;
+
+          if (samplers[i].layer >= n_samplers)
+            continue;
+
+          location = cogl_program_get_uniform_location (program,
+                                                        samplers[i].name);
+          if (location >= 0)
+            cogl_program_set_uniform_1i (program, location, samplers[i].layer);
+        }
+
+      cogl_program_use (COGL_INVALID_HANDLE);
+    }
+
+  return program;
+}
+
+/* Returns the program linked from @source registered under @key, linking
+ * it the first time it is asked for. The registry keeps the reference. Has
+ * to be called from the clutter thread */
+static CoglHandle
+clutter_gst_renderer_registry_get_program (ClutterGstRendererRegistry *registry,
+                                           const char                 *key,
+                                           const char                 *source,
+                                           int                         n_samplers)
+{
+  CoglHandle program;
+
+  program = g_hash_table_lookup (registry->programs, key);
+  if (program)
+    return program;
+
+  GST_DEBUG ("linking program for %s", key);
+
+  program = _create_cogl_program (source, n_samplers);
+  g_hash_table_insert (registry->programs, g_strdup (key), program);
+
   return program;
 }
 
+/* Sets the shared program for @variant (telling apart the sources of a
+ * renderer, or NULL) of the current renderer on the template and on the
+ * materials of the ring */
+static void
+_use_program (ClutterGstVideoSink *sink,
+              const char          *variant)
+{
+  ClutterGstVideoSinkPrivate *priv = sink->priv;
+  CoglHandle program;
+  gchar *key;
+  int i;
+
+  if (variant)
+    key = g_strdup_printf ("%s:%s", priv->renderer->name, variant);
+  else
+    key = g_strdup (priv->renderer->name);
+
+  program =
+    clutter_gst_renderer_registry_get_program (priv->registry, key,
+                                               priv->program_source,
+                                               priv->program_n_samplers);
+  g_free (key);
+
+  if (program == priv->program)
+    return;
+
+  /* the ring materials are copies of the template, they each point to the
+   * program too */
+  cogl_material_set_user_program (priv->material_template, program);
+  for (i = 0; i < CLUTTER_GST_TEXTURE_RING_SIZE; i++)
+    if (priv->ring_material[i])
+      cogl_material_set_user_program (priv->ring_material[i], program);
+
+  priv->program = program;
+
+  /* the colour matrix of the YUV programs and the field to show when
+   * deinterlacing are set before each paint. The uniforms a program does
+   * not have are at -1. The fragment programs have no named uniforms */
+  if (priv->renderer->flags & CLUTTER_GST_FP)
+    {
+      priv->yuv_matrix_location = -1;
+      priv->field_location = priv->height_location = -1;
+    }
+  else
+    {
+      priv->yuv_matrix_location =
+        cogl_program_get_uniform_location (program, "yuv_matrix");
+      priv->field_location =
+        cogl_program_get_uniform_location (program, "field");
+      priv->height_location =
+        cogl_program_get_uniform_location (program, "height");
+    }
+
+  /* looked up again as they are set */
+  priv->n_geometry = 0;
+}
+
+/* @variant tells apart the programs built from different sources for the
+ * same renderer, see _use_program() */
+static void
+_create_template_material_full (ClutterGstVideoSink *sink,
+                                const char *source,
+                                gboolean set_uniforms,
+                                int n_layers,
+                                const char *variant)
+{
+  ClutterGstVideoSinkPrivate *priv = sink->priv;
+  CoglMaterial *template;
+  int i;
+
+  if (priv->material_template)
+    cogl_object_unref (priv->material_template);
+
+  /* the materials of the ring are derived from the template */
+  for (i = 0; i < CLUTTER_GST_TEXTURE_RING_SIZE; i++)
+    {
+      if (priv->ring_material[i])
+        {
+          cogl_object_unref (priv->ring_material[i]);
+          priv->ring_material[i] = NULL;
+        }
+    }
+
+  template = cogl_material_new ();
+  priv->material_template = template;
+
+  g_free (priv->program_source);
+  priv->program_source = g_strdup (source);
+  priv->program_n_samplers = set_uniforms ? n_layers : 0;
+  priv->program = COGL_INVALID_HANDLE;
+  priv->n_geometry = 0;
+  priv->yuv_matrix_location = -1;
+  priv->field_location = priv->height_location = -1;
+
+  if (source)
+    _use_program (sink, variant);
+
+  for (i = 0; i < n_layers; i++)
+    cogl_material_set_layer (template, i, COGL_INVALID_HANDLE);
+}
+
 static void
 _create_template_material (ClutterGstVideoSink *sink,
                            const char *source,
                            gboolean set_uniforms,
                            int n_layers)
+{
+  _create_template_material_full (sink, source, set_uniforms, n_layers, NULL);
+}
+
+/* Sets the material of the current ring slot on the texture. As the
+ * textures of a slot are updated in place, the material of a slot is only
+ * created (from the template) the first time the slot is used and then
+ * reused for every frame, which keeps Cogl from having to flush its
+ * pipeline state or to look up the GL program again. Setting a layer to the
+ * texture it already has is a no-op, the layers only really change when the
+ * ring is reallocated. */
+static void
+_create_paint_material (ClutterGstVideoSink *sink,
+                        CoglHandle tex0,
+                        CoglHandle tex1,
+                        CoglHandle tex2)
+{
+  ClutterGstVideoSinkPrivate *priv= sink->priv;
+  CoglMaterial **material = &priv->ring_material[priv->ring_index];
+  GSList *l;
+
+  if (G_UNLIKELY (*material == NULL))
+    *material = cogl_material_copy (priv->material_template);
+
+  /* the textures are owned by the ring, the material takes its own
+   * reference */
+  if (tex0 != COGL_INVALID_HANDLE)
+    cogl_material_set_layer (*material, 0, tex0);
+  if (tex1 != COGL_INVALID_HANDLE)
+    cogl_material_set_layer (*material, 1, tex1);
+  if (tex2 != COGL_INVALID_HANDLE)
+    cogl_material_set_layer (*material, 2, tex2);
+
+  /* drawn offscreen by clutter_gst_autotune_draw() */
+  if (G_UNLIKELY (priv->autotuning))
+    return;
+
+  clutter_texture_set_cogl_material (priv->texture, *material);
+
+  /* the other textures show the very same frame, no need to upload it
+   * again */
+  for (l = priv->textures; l; l = l->next)
+    clutter_texture_set_cogl_material (CLUTTER_TEXTURE (l->data), *material);
+}
+
+/* Records the value of the uniform @name of the program, one or two floats
+ * depending on the geometry of the frames. It is set right before the
+ * texture is painted, see on_texture_paint() */
+static void
+_set_geometry_uniform (ClutterGstVideoSink *sink,
+                       const char          *name,
+                       int                  n_components,
+                       float                value0,
+                       float                value1)
 {
   ClutterGstVideoSinkPrivate *priv = sink->priv;
-  CoglMaterial *template;
-  int i;
+  ClutterGstGeometryUniform *uniform = NULL;
+  guint i;
+
+  if (priv->program == COGL_INVALID_HANDLE)
+    return;
+
+  for (i = 0; i < priv->n_geometry; i++)
+    if (priv->geometry[i].name == name || !strcmp (priv->geometry[i].name, name))
+      {
+        uniform = &priv->geometry[i];
+        break;
+      }
+
+  if (uniform == NULL)
+    {
+      g_return_if_fail (priv->n_geometry < CLUTTER_GST_MAX_GEOMETRY_UNIFORMS);
+
+      uniform = &priv->geometry[priv->n_geometry++];
+      uniform->name = name;
+      uniform->location =
+        cogl_program_get_uniform_location (priv->program, name);
+    }
+
+  uniform->n_components = n_components;
+  uniform->value[0] = value0;
+  uniform->value[1] = value1;
+}
+
+/* Sets the "width" uniform of the program of the template, for the shaders
+ * that need to address individual texels */
+static void
+_set_width_uniform (ClutterGstVideoSink *sink,
+                    gint                 width)
+{
+  _set_geometry_uniform (sink, "width", 1, width, 0);
+}
+
+/* Builds the matrix converting the (y, u, v, 1) samples of the frames to
+ * RGBA, applying the colour balance on the way */
+static void
+clutter_gst_video_sink_update_yuv_matrix (ClutterGstVideoSink *sink)
+{
+  ClutterGstVideoSinkPrivate *priv = sink->priv;
+  gdouble kr, kb, kg, rv, gu, gv, bu;
+  gdouble brightness, contrast, hue, saturation;
+  gdouble ys, yo, a, b, c, d, cbo, cro;
+  gfloat *m = priv->yuv_matrix;
+
+  /* luma coefficients of BT.709 for HD content, BT.601 otherwise */
+  if (g_atomic_int_get (&priv->hdtv))
+    {
+      kr = 0.2126;
+      kb = 0.0722;
+    }
+  else
+    {
+      kr = 0.299;
+      kb = 0.114;
+    }
+  kg = 1.0 - kr - kb;
+
+  rv = 2.0 * (1.0 - kr);
+  gu = -2.0 * kb * (1.0 - kb) / kg;
+  gv = -2.0 * kr * (1.0 - kr) / kg;
+  bu = 2.0 * (1.0 - kb);
+
+  /* brightness in [-1, 1], contrast and saturation in [0, 2], hue
+   * in [-pi, pi] */
+#define BALANCE(channel) \
+  ((gdouble) g_atomic_int_get (&priv->balance[CLUTTER_GST_BALANCE_##channel]) \
+   / CLUTTER_GST_BALANCE_MAX)
+  brightness = BALANCE (BRIGHTNESS);
+  contrast = BALANCE (CONTRAST) + 1.0;
+  hue = BALANCE (HUE) * G_PI;
+  saturation = BALANCE (SATURATION) + 1.0;
+#undef BALANCE
+
+  /* limited range samples: Y' = ys * y + yo, and the chroma rotated by the
+   * hue and scaled by the saturation:
+   *   Cb' = a * u + b * v + cbo
+   *   Cr' = c * u + d * v + cro */
+  ys = contrast * 255.0 / 219.0;
+  yo = brightness - ys * 16.0 / 255.0;
+  a = saturation * cos (hue) * 255.0 / 224.0;
+  b = -saturation * sin (hue) * 255.0 / 224.0;
+  c = saturation * sin (hue) * 255.0 / 224.0;
+  d = saturation * cos (hue) * 255.0 / 224.0;
+  cbo = -(a + b) * 128.0 / 255.0;
+  cro = -(c + d) * 128.0 / 255.0;
+
+  /* column major, as expected by GL */
+  m[0] = ys;
+  m[1] = ys;
+  m[2] = ys;
+  m[3] = 0.0;
+
+  m[4] = rv * c;
+  m[5] = gu * a + gv * c;
+  m[6] = bu * a;
+  m[7] = 0.0;
+
+  m[8] = rv * d;
+  m[9] = gu * b + gv * d;
+  m[10] = bu * b;
+  m[11] = 0.0;
+
+  m[12] = yo + rv * cro;
+  m[13] = yo + gu * cbo + gv * cro;
+  m[14] = yo + bu * cbo;
+  m[15] = 1.0;
+}
+
+/* Whether the uniforms of @sink are the last ones set on its program */
+static gboolean
+clutter_gst_program_uniforms_match (ClutterGstProgramUniforms *uniforms,
+                                    ClutterGstVideoSinkPrivate *priv)
+{
+  guint i;
+
+  if (!uniforms->set || uniforms->n_geometry != priv->n_geometry)
+    return FALSE;
+
+  if (priv->yuv_matrix_location >= 0 &&
+      memcmp (uniforms->yuv_matrix, priv->yuv_matrix,
+              sizeof (priv->yuv_matrix)) != 0)
+    return FALSE;
+
+  if (priv->field_location >= 0 &&
+      (uniforms->field != priv->field || uniforms->height != priv->height))
+    return FALSE;
+
+  for (i = 0; i < priv->n_geometry; i++)
+    {
+      ClutterGstGeometryUniform *last = &uniforms->geometry[i];
+      ClutterGstGeometryUniform *uniform = &priv->geometry[i];
+
+      if (last->location != uniform->location ||
+          last->n_components != uniform->n_components ||
+          last->value[0] != uniform->value[0] ||
+          last->value[1] != uniform->value[1])
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+/* The programs are shared between sinks while the colour matrix is ours,
+ * so it is set right before the material is drawn. Cogl batches the
+ * geometry and only reads the uniforms when drawing it, whatever is queued
+ * with the matrix of another sink is drawn first. Nothing is done when the
+ * program already has our values, which is the common case of several
+ * sinks with the default colour balance */
+static void
+clutter_gst_video_sink_set_uniforms (ClutterGstVideoSink *sink)
+{
+  ClutterGstVideoSinkPrivate *priv = sink->priv;
+  ClutterGstProgramUniforms *uniforms;
+  guint i;
 
-  if (priv->material_template)
-    cogl_object_unref (priv->material_template);
+  if (priv->program == COGL_INVALID_HANDLE ||
+      (priv->yuv_matrix_location < 0 && priv->field_location < 0 &&
+       priv->n_geometry == 0))
+    return;
 
-  template = cogl_material_new ();
+  if (g_atomic_int_compare_and_exchange (&priv->yuv_matrix_dirty, TRUE, FALSE))
+    clutter_gst_video_sink_update_yuv_matrix (sink);
 
-  if (source)
+  uniforms = g_hash_table_lookup (priv->registry->uniforms, priv->program);
+  if (uniforms == NULL)
+    {
+      uniforms = g_new0 (ClutterGstProgramUniforms, 1);
+      g_hash_table_insert (priv->registry->uniforms, priv->program, uniforms);
+    }
+  else if (clutter_gst_program_uniforms_match (uniforms, priv))
     {
-      CoglHandle program = _create_cogl_program (source);
+      return;
+    }
 
-      if (set_uniforms)
-        {
-          unsigned int location;
+  cogl_flush ();
 
-          cogl_program_use (program);
+  if (priv->yuv_matrix_location >= 0)
+    cogl_program_set_uniform_matrix (priv->program, priv->yuv_matrix_location,
+                                     4, 1, FALSE, priv->yuv_matrix);
 
-          location = cogl_program_get_uniform_location (program, "ytex");
-          cogl_program_set_uniform_1i (program, location, 0);
-          if (n_layers > 1)
-            {
-              location = cogl_program_get_uniform_location (program, "utex");
-              cogl_program_set_uniform_1i (program, location, 1);
-            }
-          if (n_layers > 2)
-            {
-              location = cogl_program_get_uniform_location (program, "vtex");
-              cogl_program_set_uniform_1i (program, location, 2);
-            }
+  if (priv->field_location >= 0)
+    {
+      cogl_program_set_uniform_1f (priv->program, priv->field_location,
+                                   priv->field);
+      cogl_program_set_uniform_1f (priv->program, priv->height_location,
+                                   priv->height);
+    }
 
-          cogl_program_use (COGL_INVALID_HANDLE);
-        }
+  for (i = 0; i < priv->n_geometry; i++)
+    {
+      ClutterGstGeometryUniform *uniform = &priv->geometry[i];
 
-      cogl_material_set_user_program (template, program);
-      cogl_handle_unref (program);
-    }
+      if (uniform->location < 0)
+        continue;
 
-  for (i = 0; i < n_layers; i++)
-    cogl_material_set_layer (template, i, COGL_INVALID_HANDLE);
+      if (uniform->n_components == 2)
+        cogl_program_set_uniform_2f (priv->program, uniform->location,
+                                     uniform->value[0], uniform->value[1]);
+      else
+        cogl_program_set_uniform_1f (priv->program, uniform->location,
+                                     uniform->value[0]);
+    }
 
-  priv->material_template = template;
+  uniforms->set = TRUE;
+  memcpy (uniforms->yuv_matrix, priv->yuv_matrix, sizeof (priv->yuv_matrix));
+  uniforms->field = priv->field;
+  uniforms->height = priv->height;
+  memcpy (uniforms->geometry, priv->geometry, sizeof (priv->geometry));
+  uniforms->n_geometry = priv->n_geometry;
 }
 
 static void
-_create_paint_material (ClutterGstVideoSink *sink,
-                        CoglHandle tex0,
-                        CoglHandle tex1,
-                        CoglHandle tex2)
+on_texture_paint (ClutterActor        *actor,
+                  ClutterGstVideoSink *sink)
 {
-  ClutterGstVideoSinkPrivate *priv= sink->priv;
-  CoglMaterial *material = cogl_material_copy (priv->material_template);
+  ClutterGstVideoSinkPrivate *priv = sink->priv;
 
-  if (tex0 != COGL_INVALID_HANDLE)
+  if (!priv->frame_painted)
     {
-      cogl_material_set_layer (material, 0, tex0);
-      cogl_handle_unref (tex0);
-    }
-  if (tex1 != COGL_INVALID_HANDLE)
-    {
-      cogl_material_set_layer (material, 1, tex1);
-      cogl_handle_unref (tex1);
-    }
-  if (tex2 != COGL_INVALID_HANDLE)
-    {
-      cogl_material_set_layer (material, 2, tex2);
-      cogl_handle_unref (tex2);
+      priv->frame_painted = TRUE;
+      g_atomic_int_inc (&priv->frames_painted);
+
+      if (G_UNLIKELY (priv->trace_latency))
+        clutter_gst_video_sink_trace_paint (sink);
     }
 
-  clutter_texture_set_cogl_material (priv->texture, material);
-  cogl_object_unref (material);
+  /* whatever the geometry of the texture says, it is on screen (a clone
+   * painting a texture placed off-stage for instance) */
+  priv->painted_since_check = TRUE;
+  if (G_UNLIKELY (g_atomic_int_get (&priv->hidden)))
+    clutter_gst_video_sink_update_visibility (sink);
+
+  clutter_gst_video_sink_set_uniforms (sink);
 }
 
 static void
@@ -542,13 +2443,8 @@ clutter_gst_rgb24_upload (ClutterGstVideoSink *sink,
   else
     format = COGL_PIXEL_FORMAT_RGB_888;
 
-  tex = cogl_texture_new_from_data (priv->width,
-                                    priv->height,
-                                    CLUTTER_GST_TEXTURE_FLAGS,
-                                    format,
-                                    format,
-                                    GST_ROUND_UP_4 (3 * priv->width),
-                                    GST_BUFFER_DATA (buffer));
+  clutter_gst_texture_ring_advance (sink, buffer);
+  tex = clutter_gst_texture_ring_upload (sink, 0, format, buffer);
 
   _create_paint_material (sink,
                           tex,
@@ -584,13 +2480,8 @@ clutter_gst_rgb32_upload (ClutterGstVideoSink *sink,
   else
     format = COGL_PIXEL_FORMAT_RGBA_8888;
 
-  tex = cogl_texture_new_from_data (priv->width,
-                                    priv->height,
-                                    CLUTTER_GST_TEXTURE_FLAGS,
-                                    format,
-                                    format,
-                                    GST_ROUND_UP_4 (4 * priv->width),
-                                    GST_BUFFER_DATA (buffer));
+  clutter_gst_texture_ring_advance (sink, buffer);
+  tex = clutter_gst_texture_ring_upload (sink, 0, format, buffer);
 
   _create_paint_material (sink,
                           tex,
@@ -619,37 +2510,21 @@ static void
 clutter_gst_yv12_upload (ClutterGstVideoSink *sink,
                          GstBuffer           *buffer)
 {
-  ClutterGstVideoSinkPrivate *priv = sink->priv;
-  gint y_row_stride  = GST_ROUND_UP_4 (priv->width);
-  gint uv_row_stride = GST_ROUND_UP_4 (priv->width / 2);
   CoglHandle y_tex, u_tex, v_tex;
 
-  y_tex = cogl_texture_new_from_data (priv->width,
-                                      priv->height,
-                                      CLUTTER_GST_TEXTURE_FLAGS,
-                                      COGL_PIXEL_FORMAT_G_8,
-                                      COGL_PIXEL_FORMAT_G_8,
-                                      y_row_stride,
-                                      GST_BUFFER_DATA (buffer));
-
-  u_tex = cogl_texture_new_from_data (priv->width / 2,
-                                      priv->height / 2,
-                                      CLUTTER_GST_TEXTURE_FLAGS,
-                                      COGL_PIXEL_FORMAT_G_8,
-                                      COGL_PIXEL_FORMAT_G_8,
-                                      uv_row_stride,
-                                      GST_BUFFER_DATA (buffer) +
-                                      (y_row_stride * priv->height));
-
-  v_tex = cogl_texture_new_from_data (priv->width / 2,
-                                      priv->height / 2,
-                                      CLUTTER_GST_TEXTURE_FLAGS,
-                                      COGL_PIXEL_FORMAT_G_8,
-                                      COGL_PIXEL_FORMAT_G_8,
-                                      uv_row_stride,
-                                      GST_BUFFER_DATA (buffer)
-                                      + (y_row_stride * priv->height)
-                                      + (uv_row_stride * priv->height / 2));
+  clutter_gst_texture_ring_advance (sink, buffer);
+
+  y_tex = clutter_gst_texture_ring_upload (sink, 0,
+                                           COGL_PIXEL_FORMAT_G_8,
+                                           buffer);
+
+  u_tex = clutter_gst_texture_ring_upload (sink, 1,
+                                           COGL_PIXEL_FORMAT_G_8,
+                                           buffer);
+
+  v_tex = clutter_gst_texture_ring_upload (sink, 2,
+                                           COGL_PIXEL_FORMAT_G_8,
+                                           buffer);
 
   _create_paint_material (sink, y_tex, u_tex, v_tex);
 }
@@ -745,102 +2620,499 @@ clutter_gst_i420_fp_init (ClutterGstVideoSink *sink)
   g_free (shader);
 }
 
-static ClutterGstRenderer i420_fp_renderer =
+static ClutterGstRenderer i420_fp_renderer =
+{
+  "I420 fp",
+  CLUTTER_GST_I420,
+  CLUTTER_GST_FP | CLUTTER_GST_MULTI_TEXTURE,
+  GST_STATIC_CAPS (GST_VIDEO_CAPS_YUV ("I420")),
+  clutter_gst_i420_fp_init,
+  clutter_gst_dummy_deinit,
+  clutter_gst_yv12_upload,
+};
+#endif
+
+/*
+ * I420 / YV12 (deinterlacing version)
+ *
+ * Same layout as the GLSL renderers, with the luma plane of the previous
+ * frame of the ring as fourth layer for the motion adaptive mode.
+ */
+
+static gboolean
+clutter_gst_deinterlace_accept (ClutterGstVideoSink *sink)
+{
+  ClutterGstVideoSinkPrivate *priv = sink->priv;
+
+  return priv->interlaced &&
+         priv->deinterlace_mode != CLUTTER_GST_DEINTERLACE_MODE_NONE;
+}
+
+static void
+clutter_gst_deinterlace_init_common (ClutterGstVideoSink *sink,
+                                     guint                planar_order)
+{
+  ClutterGstVideoSinkPrivate *priv = sink->priv;
+  GEnumClass *enum_class;
+  GEnumValue *mode;
+
+  enum_class = g_type_class_ref (CLUTTER_GST_TYPE_DEINTERLACE_MODE);
+  mode = g_enum_get_value (enum_class, priv->deinterlace_mode);
+
+  _create_template_material_full (sink,
+                                  deinterlace_shaders[mode->value][planar_order],
+                                  TRUE, 4,
+                                  mode->value_nick);
+
+  g_type_class_unref (enum_class);
+}
+
+static void
+clutter_gst_i420_deinterlace_init (ClutterGstVideoSink *sink)
+{
+  clutter_gst_deinterlace_init_common (sink, 0);
+}
+
+static void
+clutter_gst_yv12_deinterlace_init (ClutterGstVideoSink *sink)
+{
+  clutter_gst_deinterlace_init_common (sink, 1);
+}
+
+static void
+clutter_gst_deinterlace_cancel_second_field (ClutterGstVideoSink *sink)
+{
+  ClutterGstVideoSinkPrivate *priv = sink->priv;
+
+  if (priv->second_field)
+    {
+      g_source_destroy (priv->second_field);
+      g_source_unref (priv->second_field);
+      priv->second_field = NULL;
+    }
+}
+
+static void
+clutter_gst_deinterlace_deinit (ClutterGstVideoSink *sink)
+{
+  clutter_gst_deinterlace_cancel_second_field (sink);
+}
+
+static gboolean
+clutter_gst_deinterlace_show_second_field (gpointer data)
+{
+  ClutterGstVideoSink *sink = CLUTTER_GST_VIDEO_SINK (data);
+  ClutterGstVideoSinkPrivate *priv = sink->priv;
+
+  g_source_unref (priv->second_field);
+  priv->second_field = NULL;
+
+  priv->field = 1.0 - priv->field;
+  clutter_gst_video_sink_queue_redraw (sink);
+
+  return FALSE;
+}
+
+static void
+clutter_gst_deinterlace_upload (ClutterGstVideoSink *sink,
+                                GstBuffer           *buffer)
+{
+  ClutterGstVideoSinkPrivate *priv = sink->priv;
+  CoglHandle prev;
+  guint prev_index;
+
+  clutter_gst_deinterlace_cancel_second_field (sink);
+
+  clutter_gst_yv12_upload (sink, buffer);
+
+  /* the slot before the current one holds the previous frame, the current
+   * frame stands in for it until the ring has been filled */
+  prev_index = (priv->ring_index + CLUTTER_GST_TEXTURE_RING_SIZE - 1) %
+               CLUTTER_GST_TEXTURE_RING_SIZE;
+  prev = priv->ring[prev_index][0];
+  if (prev == COGL_INVALID_HANDLE)
+    prev = priv->ring[priv->ring_index][0];
+  cogl_material_set_layer (priv->ring_material[priv->ring_index], 3, prev);
+
+  /* frames without the TFF flag are bottom field first */
+  priv->field =
+    GST_BUFFER_FLAG_IS_SET (buffer, GST_VIDEO_BUFFER_TFF) ? 0.0 : 1.0;
+
+  /* the blend shows both fields at once, there is no second field */
+  if (priv->deinterlace_double_rate &&
+      priv->deinterlace_mode != CLUTTER_GST_DEINTERLACE_MODE_LINEAR)
+    {
+      GstClockTime duration = GST_BUFFER_DURATION (buffer);
+
+      if (!GST_CLOCK_TIME_IS_VALID (duration) && priv->fps_n > 0)
+        duration = gst_util_uint64_scale_int (GST_SECOND,
+                                              priv->fps_d, priv->fps_n);
+
+      if (GST_CLOCK_TIME_IS_VALID (duration))
+        {
+          priv->second_field =
+            g_timeout_source_new (duration / (2 * GST_MSECOND));
+          g_source_set_callback (priv->second_field,
+                                 clutter_gst_deinterlace_show_second_field,
+                                 sink, NULL);
+          g_source_attach (priv->second_field, priv->clutter_main_context);
+        }
+    }
+}
+
+static ClutterGstRenderer i420_deinterlace_renderer =
+{
+  "I420 glsl deinterlace",
+  CLUTTER_GST_I420,
+  CLUTTER_GST_GLSL | CLUTTER_GST_MULTI_TEXTURE,
+  GST_STATIC_CAPS (GST_VIDEO_CAPS_YUV ("I420")),
+  clutter_gst_i420_deinterlace_init,
+  clutter_gst_deinterlace_deinit,
+  clutter_gst_deinterlace_upload,
+  clutter_gst_deinterlace_accept,
+};
+
+static ClutterGstRenderer yv12_deinterlace_renderer =
+{
+  "YV12 glsl deinterlace",
+  CLUTTER_GST_YV12,
+  CLUTTER_GST_GLSL | CLUTTER_GST_MULTI_TEXTURE,
+  GST_STATIC_CAPS (GST_VIDEO_CAPS_YUV ("YV12")),
+  clutter_gst_yv12_deinterlace_init,
+  clutter_gst_deinterlace_deinit,
+  clutter_gst_deinterlace_upload,
+  clutter_gst_deinterlace_accept,
+};
+
+/*
+ * I420 / YV12 (single texture version)
+ *
+ * The whole frame is uploaded in one go as a luminance texture as wide as
+ * the luma rows and 1.5 times as tall as the (rounded) picture. This is only
+ * possible when two rows of chroma samples exactly fill a row of luma
+ * samples, ie. when the width is a multiple of 8.
+ *
+ * One upload instead of three is a win when the fixed cost of each upload
+ * outweighs the longer shader, which is the case of small frames. Larger
+ * ones only get this renderer when autotuning measured it as the fastest,
+ * or when it is the only one able to display them.
+ */
+
+/* frames up to CIF size */
+#define CLUTTER_GST_SINGLE_TEXTURE_MAX_AREA (352 * 288)
+
+static gboolean
+clutter_gst_planar_single_accept (ClutterGstVideoSink *sink)
+{
+  ClutterGstVideoSinkPrivate *priv = sink->priv;
+  const ClutterGstPlane *planes = priv->planes;
+
+  return priv->n_planes == 3 &&
+         planes[0].rowstride == 2 * planes[1].rowstride &&
+         planes[1].rowstride == planes[2].rowstride &&
+         planes[1].offset % planes[0].rowstride == 0 &&
+         planes[2].offset ==
+           planes[1].offset + planes[1].rowstride * planes[1].height;
+}
+
+static gboolean
+clutter_gst_planar_single_preferred (ClutterGstVideoSink *sink)
+{
+  ClutterGstVideoSinkPrivate *priv = sink->priv;
+
+  return priv->width * priv->height <= CLUTTER_GST_SINGLE_TEXTURE_MAX_AREA;
+}
+
+static void
+clutter_gst_planar_single_init (ClutterGstVideoSink *sink,
+                                const char          *shader)
+{
+  _create_template_material (sink, shader, TRUE, 1);
+}
+
+static void
+clutter_gst_i420_single_init (ClutterGstVideoSink *sink)
+{
+  clutter_gst_planar_single_init (sink, i420_single_to_rgba_shader);
+}
+
+static void
+clutter_gst_yv12_single_init (ClutterGstVideoSink *sink)
+{
+  clutter_gst_planar_single_init (sink, yv12_single_to_rgba_shader);
+}
+
+static void
+clutter_gst_planar_single_upload (ClutterGstVideoSink *sink,
+                                  GstBuffer           *buffer)
+{
+  ClutterGstVideoSinkPrivate *priv = sink->priv;
+  const ClutterGstPlane *planes = priv->planes;
+  ClutterGstPlane layout;
+  gint chroma_row;
+  CoglHandle tex;
+
+  chroma_row = planes[1].offset / planes[0].rowstride;
+
+  layout.offset = 0;
+  layout.rowstride = planes[0].rowstride;
+  layout.width = planes[0].rowstride;
+  layout.height = chroma_row + planes[1].height;
+
+  clutter_gst_texture_ring_advance (sink, buffer);
+  tex = clutter_gst_texture_ring_upload_layout (sink, 0, &layout,
+                                                COGL_PIXEL_FORMAT_G_8,
+                                                buffer);
+
+  _set_geometry_uniform (sink, "size", 2, priv->width, priv->height);
+  _set_geometry_uniform (sink, "tex_size", 2, layout.width, layout.height);
+  _set_geometry_uniform (sink, "chroma_size", 2,
+                         planes[1].width, planes[1].height);
+  _set_geometry_uniform (sink, "chroma_row", 1, chroma_row, 0);
+
+  _create_paint_material (sink,
+                          tex,
+                          COGL_INVALID_HANDLE,
+                          COGL_INVALID_HANDLE);
+}
+
+static ClutterGstRenderer i420_single_renderer =
+{
+  "I420 glsl single texture",
+  CLUTTER_GST_I420,
+  CLUTTER_GST_GLSL,
+  GST_STATIC_CAPS (GST_VIDEO_CAPS_YUV ("I420")),
+  clutter_gst_i420_single_init,
+  clutter_gst_dummy_deinit,
+  clutter_gst_planar_single_upload,
+  clutter_gst_planar_single_accept,
+};
+
+static ClutterGstRenderer yv12_single_renderer =
+{
+  "YV12 glsl single texture",
+  CLUTTER_GST_YV12,
+  CLUTTER_GST_GLSL,
+  GST_STATIC_CAPS (GST_VIDEO_CAPS_YUV ("YV12")),
+  clutter_gst_yv12_single_init,
+  clutter_gst_dummy_deinit,
+  clutter_gst_planar_single_upload,
+  clutter_gst_planar_single_accept,
+};
+
+/*
+ * AYUV
+ *
+ * This is a 4:4:4 YUV format with 8 bit samples for each component along
+ * with an 8 bit alpha blend value per pixel. Component ordering is A Y U V
+ * (as the name suggests).
+ */
+
+static void
+clutter_gst_ayuv_glsl_init(ClutterGstVideoSink *sink)
+{
+  _create_template_material (sink, ayuv_to_rgba_shader, TRUE, 1);
+}
+
+static void
+clutter_gst_ayuv_upload (ClutterGstVideoSink *sink,
+                         GstBuffer           *buffer)
+{
+  CoglHandle tex;
+
+  clutter_gst_texture_ring_advance (sink, buffer);
+  tex = clutter_gst_texture_ring_upload (sink, 0,
+                                         COGL_PIXEL_FORMAT_RGBA_8888,
+                                         buffer);
+
+  _create_paint_material (sink,
+                          tex,
+                          COGL_INVALID_HANDLE,
+                          COGL_INVALID_HANDLE);
+}
+
+static ClutterGstRenderer ayuv_glsl_renderer =
+{
+  "AYUV glsl",
+  CLUTTER_GST_AYUV,
+  CLUTTER_GST_GLSL,
+  GST_STATIC_CAPS (GST_VIDEO_CAPS_YUV ("AYUV")),
+  clutter_gst_ayuv_glsl_init,
+  clutter_gst_dummy_deinit,
+  clutter_gst_ayuv_upload,
+};
+
+/*
+ * NV12 / NV21
+ *
+ * 8 bit Y plane followed by a plane of interleaved 8 bit 2x2 subsampled
+ * U and V samples (V and U for NV21).
+ */
+
+static void
+clutter_gst_nv12_glsl_init_common (ClutterGstVideoSink *sink,
+                                   const char          *shader)
+{
+  ClutterGstVideoSinkPrivate *priv = sink->priv;
+
+  _create_template_material (sink, shader, TRUE, 2);
+
+  /* the shader picks the chroma samples itself, don't blend the U and V
+   * texels together */
+  cogl_material_set_layer_filters (priv->material_template, 1,
+                                   COGL_MATERIAL_FILTER_NEAREST,
+                                   COGL_MATERIAL_FILTER_NEAREST);
+}
+
+static void
+clutter_gst_nv12_glsl_init (ClutterGstVideoSink *sink)
+{
+  clutter_gst_nv12_glsl_init_common (sink, nv12_to_rgba_shader);
+}
+
+static void
+clutter_gst_nv21_glsl_init (ClutterGstVideoSink *sink)
+{
+  clutter_gst_nv12_glsl_init_common (sink, nv21_to_rgba_shader);
+}
+
+static void
+clutter_gst_nv12_upload (ClutterGstVideoSink *sink,
+                         GstBuffer           *buffer)
+{
+  ClutterGstVideoSinkPrivate *priv = sink->priv;
+  CoglHandle y_tex, uv_tex;
+
+  clutter_gst_texture_ring_advance (sink, buffer);
+
+  y_tex = clutter_gst_texture_ring_upload (sink, 0,
+                                           COGL_PIXEL_FORMAT_G_8,
+                                           buffer);
+
+  uv_tex = clutter_gst_texture_ring_upload (sink, 1,
+                                            COGL_PIXEL_FORMAT_G_8,
+                                            buffer);
+
+  _set_width_uniform (sink, priv->planes[1].width);
+  _create_paint_material (sink, y_tex, uv_tex, COGL_INVALID_HANDLE);
+}
+
+static ClutterGstRenderer nv12_glsl_renderer =
 {
-  "I420 fp",
-  CLUTTER_GST_I420,
-  CLUTTER_GST_FP | CLUTTER_GST_MULTI_TEXTURE,
-  GST_STATIC_CAPS (GST_VIDEO_CAPS_YUV ("I420")),
-  clutter_gst_i420_fp_init,
+  "NV12 glsl",
+  CLUTTER_GST_NV12,
+  CLUTTER_GST_GLSL | CLUTTER_GST_MULTI_TEXTURE,
+  GST_STATIC_CAPS (GST_VIDEO_CAPS_YUV ("NV12")),
+  clutter_gst_nv12_glsl_init,
   clutter_gst_dummy_deinit,
-  clutter_gst_yv12_upload,
+  clutter_gst_nv12_upload,
+};
+
+static ClutterGstRenderer nv21_glsl_renderer =
+{
+  "NV21 glsl",
+  CLUTTER_GST_NV21,
+  CLUTTER_GST_GLSL | CLUTTER_GST_MULTI_TEXTURE,
+  GST_STATIC_CAPS (GST_VIDEO_CAPS_YUV ("NV21")),
+  clutter_gst_nv21_glsl_init,
+  clutter_gst_dummy_deinit,
+  clutter_gst_nv12_upload,
 };
-#endif
 
 /*
- * AYUV
+ * YUY2 / UYVY
  *
- * This is a 4:4:4 YUV format with 8 bit samples for each component along
- * with an 8 bit alpha blend value per pixel. Component ordering is A Y U V
- * (as the name suggests).
+ * Packed 4:2:2 formats, 2 pixels per 32 bits macropixel with the components
+ * ordered Y0 U Y1 V (YUY2) or U Y0 V Y1 (UYVY).
  */
 
 static void
-clutter_gst_ayuv_glsl_init(ClutterGstVideoSink *sink)
+clutter_gst_yuy2_glsl_init (ClutterGstVideoSink *sink)
 {
-  _create_template_material (sink, ayuv_to_rgba_shader, TRUE, 1);
+  _create_template_material (sink, yuy2_to_rgba_shader, TRUE, 1);
 }
 
 static void
-clutter_gst_ayuv_upload (ClutterGstVideoSink *sink,
+clutter_gst_uyvy_glsl_init (ClutterGstVideoSink *sink)
+{
+  _create_template_material (sink, uyvy_to_rgba_shader, TRUE, 1);
+}
+
+static void
+clutter_gst_yuy2_upload (ClutterGstVideoSink *sink,
                          GstBuffer           *buffer)
 {
   ClutterGstVideoSinkPrivate *priv = sink->priv;
-  CoglHandle tex =
-    cogl_texture_new_from_data (priv->width,
-                                priv->height,
-                                CLUTTER_GST_TEXTURE_FLAGS,
-                                COGL_PIXEL_FORMAT_RGBA_8888,
-                                COGL_PIXEL_FORMAT_RGBA_8888,
-                                GST_ROUND_UP_4 (4 * priv->width),
-                                GST_BUFFER_DATA (buffer));
+  CoglHandle tex;
 
+  clutter_gst_texture_ring_advance (sink, buffer);
+  tex = clutter_gst_texture_ring_upload (sink, 0,
+                                         COGL_PIXEL_FORMAT_RGBA_8888,
+                                         buffer);
+
+  _set_width_uniform (sink, priv->planes[0].width);
   _create_paint_material (sink,
                           tex,
                           COGL_INVALID_HANDLE,
                           COGL_INVALID_HANDLE);
 }
 
-static ClutterGstRenderer ayuv_glsl_renderer =
+static ClutterGstRenderer yuy2_glsl_renderer =
 {
-  "AYUV glsl",
-  CLUTTER_GST_AYUV,
+  "YUY2 glsl",
+  CLUTTER_GST_YUY2,
   CLUTTER_GST_GLSL,
-  GST_STATIC_CAPS (GST_VIDEO_CAPS_YUV ("AYUV")),
-  clutter_gst_ayuv_glsl_init,
+  GST_STATIC_CAPS (GST_VIDEO_CAPS_YUV ("YUY2")),
+  clutter_gst_yuy2_glsl_init,
   clutter_gst_dummy_deinit,
-  clutter_gst_ayuv_upload,
+  clutter_gst_yuy2_upload,
+};
+
+static ClutterGstRenderer uyvy_glsl_renderer =
+{
+  "UYVY glsl",
+  CLUTTER_GST_UYVY,
+  CLUTTER_GST_GLSL,
+  GST_STATIC_CAPS (GST_VIDEO_CAPS_YUV ("UYVY")),
+  clutter_gst_uyvy_glsl_init,
+  clutter_gst_dummy_deinit,
+  clutter_gst_yuy2_upload,
 };
 
 static GSList *
-clutter_gst_build_renderers_list (void)
+clutter_gst_build_renderers_list (gint features)
 {
   GSList             *list = NULL;
-  GLint               nb_texture_units = 0;
-  gint                features = 0, i;
+  gint                i;
   /* The order of the list of renderers is important. They will be prepended
    * to a GSList and we'll iterate over that list to choose the first matching
-   * renderer. Thus if you want to use the fp renderer over the glsl one, the
-   * fp renderer has to be put after the glsl one in this array */
+   * renderer. The fp renderers ignore the color matrix (colorimetry and
+   * color balance), they come before the glsl ones in this array so that
+   * they are only used when GLSL is not available. The single texture
+   * renderers come after the glsl ones but are only picked for small
+   * frames, see clutter_gst_find_renderer_by_format() */
   ClutterGstRenderer *renderers[] =
     {
       &rgb24_renderer,
       &rgb32_renderer,
-      &yv12_glsl_renderer,
-      &i420_glsl_renderer,
 #ifdef CLUTTER_COGL_HAS_GL
       &yv12_fp_renderer,
       &i420_fp_renderer,
 #endif
+      &yv12_glsl_renderer,
+      &i420_glsl_renderer,
+      &yv12_single_renderer,
+      &i420_single_renderer,
+      &nv12_glsl_renderer,
+      &nv21_glsl_renderer,
       &ayuv_glsl_renderer,
+      &yuy2_glsl_renderer,
+      &uyvy_glsl_renderer,
+      &yv12_deinterlace_renderer,
+      &i420_deinterlace_renderer,
       NULL
     };
 
-  nb_texture_units = get_n_fragment_texture_units();
-
-  if (nb_texture_units >= 3)
-    features |= CLUTTER_GST_MULTI_TEXTURE;
-
-#ifdef CLUTTER_COGL_HAS_GL
-  if (cogl_features_available (COGL_FEATURE_SHADERS_ARBFP))
-    features |= CLUTTER_GST_FP;
-#endif
-
-  if (cogl_features_available (COGL_FEATURE_SHADERS_GLSL))
-    features |= CLUTTER_GST_GLSL;
-
-  GST_INFO ("GL features: 0x%08x", features);
-
   for (i = 0; renderers[i]; i++)
     {
       gint needed = renderers[i]->flags;
@@ -876,26 +3148,568 @@ clutter_gst_build_caps (GSList *renderers)
   return caps;
 }
 
-static ClutterGstRenderer *
-clutter_gst_find_renderer_by_format (ClutterGstVideoSink  *sink,
-                                     ClutterGstVideoFormat format)
+static gint
+clutter_gst_probe_features (void)
+{
+  GLint nb_texture_units = 0;
+  gint features = 0;
+
+  nb_texture_units = get_n_fragment_texture_units();
+
+  if (nb_texture_units >= 3)
+    features |= CLUTTER_GST_MULTI_TEXTURE;
+
+#ifdef CLUTTER_COGL_HAS_GL
+  if (cogl_features_available (COGL_FEATURE_SHADERS_ARBFP))
+    features |= CLUTTER_GST_FP;
+#endif
+
+  if (cogl_features_available (COGL_FEATURE_SHADERS_GLSL))
+    features |= CLUTTER_GST_GLSL;
+
+  GST_INFO ("GL features: 0x%08x", features);
+
+  return features;
+}
+
+/*
+ * Renderer autotuning
+ *
+ * When enabled, with clutter_gst_video_sink_set_autotune() or by setting
+ * CLUTTER_GST_AUTOTUNE in the environment, the first time a format is
+ * displayed at a given size class (see clutter_gst_autotune_get_key())
+ * every renderer able to handle it uploads and draws a few synthetic frames
+ * offscreen and the fastest one is used from then on for that format and
+ * size class. The
+ * results are cached in the user cache directory, keyed by the GL renderer
+ * and version strings and the version of the library, along with the GL
+ * features so that later runs skip both the probe and the linking of the
+ * programs of the renderers that lost.
+ */
+
+#define CLUTTER_GST_AUTOTUNE_FRAMES     16
+#define CLUTTER_GST_AUTOTUNE_FEATURES   "features"
+
+/* set by clutter_gst_video_sink_set_autotune(), -1 when it was not called.
+ * Protected by the registry lock */
+static gint clutter_gst_autotune = -1;
+
+/* called with the registry lock held */
+static gboolean
+clutter_gst_autotune_enabled (void)
+{
+  const char *env_string;
+
+  if (clutter_gst_autotune >= 0)
+    return clutter_gst_autotune;
+
+  env_string = g_getenv ("CLUTTER_GST_AUTOTUNE");
+
+  return env_string != NULL && strcmp (env_string, "0") != 0;
+}
+
+static gchar *
+clutter_gst_autotune_get_cache_file (void)
+{
+  return g_build_filename (g_get_user_cache_dir (),
+                           "clutter-gst",
+                           "renderers.ini",
+                           NULL);
+}
+
+/* called with the registry lock held */
+static void
+clutter_gst_renderer_registry_save_tuning (ClutterGstRendererRegistry *registry)
+{
+  GError *error = NULL;
+  gchar *filename, *dirname, *data;
+  gsize length;
+
+  filename = clutter_gst_autotune_get_cache_file ();
+  dirname = g_path_get_dirname (filename);
+  data = g_key_file_to_data (registry->tuning, &length, NULL);
+
+  g_mkdir_with_parents (dirname, 0755);
+  if (!g_file_set_contents (filename, data, length, &error))
+    {
+      GST_WARNING ("could not save the renderer tuning: %s", error->message);
+      g_error_free (error);
+    }
+
+  g_free (data);
+  g_free (dirname);
+  g_free (filename);
+}
+
+/* Loads the results cached for the GL driver in use. The features of the
+ * driver are read from the cache too unless @probed, in which case
+ * registry->features is already set. Called with the registry lock held */
+static void
+clutter_gst_renderer_registry_load_tuning (ClutterGstRendererRegistry *registry,
+                                           gboolean                    probed)
+{
+  const char *gl_renderer, *gl_version;
+  gchar *filename;
+
+#ifdef CLUTTER_COGL_HAS_GL
+  gl_renderer = (const char *) glGetString (GL_RENDERER);
+  gl_version = (const char *) glGetString (GL_VERSION);
+#else
+  /* without desktop GL the driver can't be asked directly, the version of
+   * clutter (and so of the Cogl it was built with) is the next best thing */
+  gl_renderer = "cogl";
+  gl_version = "clutter " CLUTTER_VERSION_S;
+#endif
+
+  /* a driver update or a new version of the renderers can change the
+   * outcome */
+  registry->tuning_group =
+    g_strdup_printf ("%s / %s / clutter-gst %s",
+                     gl_renderer ? gl_renderer : "unknown",
+                     gl_version ? gl_version : "unknown",
+                     PACKAGE_VERSION);
+  /* brackets are not allowed in group names */
+  g_strdelimit (registry->tuning_group, "[]", '_');
+
+  registry->tuning = g_key_file_new ();
+
+  filename = clutter_gst_autotune_get_cache_file ();
+  g_key_file_load_from_file (registry->tuning, filename,
+                             G_KEY_FILE_NONE, NULL);
+  g_free (filename);
+
+  if (!probed &&
+      g_key_file_has_key (registry->tuning, registry->tuning_group,
+                          CLUTTER_GST_AUTOTUNE_FEATURES, NULL))
+    {
+      registry->features = g_key_file_get_integer (registry->tuning,
+                                                   registry->tuning_group,
+                                                   CLUTTER_GST_AUTOTUNE_FEATURES,
+                                                   NULL);
+
+      GST_INFO ("GL features of %s: 0x%08x (cached)",
+                registry->tuning_group, registry->features);
+      return;
+    }
+
+  if (!probed)
+    registry->features = clutter_gst_probe_features ();
+  g_key_file_set_integer (registry->tuning, registry->tuning_group,
+                          CLUTTER_GST_AUTOTUNE_FEATURES, registry->features);
+  clutter_gst_renderer_registry_save_tuning (registry);
+}
+
+/* The fastest renderer depends on the size of the frames as much as on
+ * their format (the single texture renderers only win on small frames), the
+ * results are kept per format and size class, with the same threshold as
+ * clutter_gst_planar_single_preferred() */
+static gchar *
+clutter_gst_autotune_get_key (ClutterGstVideoFormat format,
+                              gboolean              small)
+{
+  return g_strdup_printf ("%s-%s", clutter_gst_video_format_names[format],
+                          small ? "small" : "large");
+}
+
+/* Returns the fastest renderer measured for @format and frames of the size
+ * class @small, if any. The renderer still has to accept the frames */
+static ClutterGstRenderer *
+clutter_gst_renderer_registry_get_tuned (ClutterGstRendererRegistry *registry,
+                                         ClutterGstVideoFormat       format,
+                                         gboolean                    small)
+{
+  ClutterGstRenderer *renderer = NULL;
+  gchar *key, *name;
+  GSList *element;
+
+  key = clutter_gst_autotune_get_key (format, small);
+
+  G_LOCK (renderer_registry);
+  if (registry->autotune)
+    name = g_key_file_get_string (registry->tuning, registry->tuning_group,
+                                  key, NULL);
+  else
+    name = NULL;
+  G_UNLOCK (renderer_registry);
+
+  g_free (key);
+
+  if (name == NULL)
+    return NULL;
+
+  for (element = registry->renderers; element; element = element->next)
+    {
+      ClutterGstRenderer *candidate = element->data;
+
+      if (candidate->format == format && strcmp (candidate->name, name) == 0)
+        {
+          renderer = candidate;
+          break;
+        }
+    }
+
+  g_free (name);
+
+  return renderer;
+}
+
+static void
+clutter_gst_renderer_registry_set_tuned (ClutterGstRendererRegistry *registry,
+                                         ClutterGstVideoFormat       format,
+                                         gboolean                    small,
+                                         ClutterGstRenderer         *renderer)
+{
+  gchar *key;
+
+  key = clutter_gst_autotune_get_key (format, small);
+
+  G_LOCK (renderer_registry);
+  g_key_file_set_string (registry->tuning, registry->tuning_group,
+                         key, renderer->name);
+  clutter_gst_renderer_registry_save_tuning (registry);
+  G_UNLOCK (renderer_registry);
+
+  g_free (key);
+}
+
+/* Returns a new reference to the registry, building it the first time */
+static ClutterGstRendererRegistry *
+clutter_gst_renderer_registry_get (void)
+{
+  ClutterGstRendererRegistry *registry;
+
+  G_LOCK (renderer_registry);
+
+  if (renderer_registry == NULL)
+    {
+      registry = g_slice_new0 (ClutterGstRendererRegistry);
+      registry->ref_count = 1;
+      registry->autotune = clutter_gst_autotune_enabled ();
+      if (registry->autotune)
+        clutter_gst_renderer_registry_load_tuning (registry, FALSE);
+      else
+        registry->features = clutter_gst_probe_features ();
+      registry->renderers =
+        clutter_gst_build_renderers_list (registry->features);
+      registry->caps = clutter_gst_build_caps (registry->renderers);
+      registry->programs =
+        g_hash_table_new_full (g_str_hash, g_str_equal,
+                               g_free, (GDestroyNotify) cogl_handle_unref);
+      registry->uniforms =
+        g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_free);
+
+      renderer_registry = registry;
+    }
+  else
+    {
+      registry = renderer_registry;
+      g_atomic_int_inc (&registry->ref_count);
+    }
+
+  G_UNLOCK (renderer_registry);
+
+  return registry;
+}
+
+static gboolean
+clutter_gst_renderer_registry_free_programs (gpointer data)
+{
+  g_hash_table_destroy ((GHashTable *) data);
+
+  return FALSE;
+}
+
+/* The programs are released with the last sink. The sinks can be finalized
+ * from any thread while Cogl can only be called from the clutter one, the
+ * programs are destroyed from there */
+static void
+clutter_gst_renderer_registry_unref (ClutterGstRendererRegistry *registry)
+{
+  GSource *source;
+
+  G_LOCK (renderer_registry);
+
+  if (!g_atomic_int_dec_and_test (&registry->ref_count))
+    {
+      G_UNLOCK (renderer_registry);
+      return;
+    }
+
+  renderer_registry = NULL;
+
+  G_UNLOCK (renderer_registry);
+
+  source = g_idle_source_new ();
+  g_source_set_callback (source, clutter_gst_renderer_registry_free_programs,
+                         registry->programs, NULL);
+  g_source_attach (source, g_main_context_default ());
+  g_source_unref (source);
+
+  g_hash_table_destroy (registry->uniforms);
+  if (registry->tuning)
+    g_key_file_free (registry->tuning);
+  g_free (registry->tuning_group);
+  gst_caps_unref (registry->caps);
+  g_slist_free (registry->renderers);
+  g_slice_free (ClutterGstRendererRegistry, registry);
+}
+
+/* Draws the material of the current slot of the ring in @offscreen, which
+ * is what painting the texture costs without the rest of the scene. The
+ * textures of the sink are left alone */
+static void
+clutter_gst_autotune_draw (ClutterGstVideoSink *sink,
+                           CoglHandle           offscreen)
+{
+  ClutterGstVideoSinkPrivate *priv = sink->priv;
+  CoglMatrix identity;
+
+  cogl_matrix_init_identity (&identity);
+
+  cogl_push_framebuffer (offscreen);
+  cogl_set_modelview_matrix (&identity);
+  cogl_set_projection_matrix (&identity);
+  clutter_gst_video_sink_set_uniforms (sink);
+  cogl_set_source (priv->ring_material[priv->ring_index]);
+  cogl_rectangle (-1, -1, 1, 1);
+  cogl_pop_framebuffer ();
+}
+
+/* Waits for the GPU to be done with what was drawn in @offscreen: reading
+ * a pixel back can only happen once the rendering is complete */
+static void
+clutter_gst_autotune_finish (CoglHandle offscreen)
+{
+  guint8 pixel[4];
+
+  cogl_push_framebuffer (offscreen);
+  cogl_flush ();
+  cogl_read_pixels (0, 0, 1, 1, COGL_READ_PIXELS_COLOR_BUFFER,
+                    COGL_PIXEL_FORMAT_RGBA_8888_PRE, pixel);
+  cogl_pop_framebuffer ();
+}
+
+static gdouble
+clutter_gst_autotune_time_renderer (ClutterGstVideoSink *sink,
+                                    ClutterGstRenderer  *renderer,
+                                    GstBuffer           *frame,
+                                    CoglHandle           offscreen)
+{
+  ClutterGstVideoSinkPrivate *priv = sink->priv;
+  GTimer *timer;
+  gdouble elapsed;
+  int i;
+
+  priv->renderer = renderer;
+  priv->autotuning = TRUE;
+  renderer->init (sink);
+
+  /* fill the ring and get the program linked before timing anything */
+  for (i = 0; i < CLUTTER_GST_TEXTURE_RING_SIZE; i++)
+    {
+      renderer->upload (sink, frame);
+      clutter_gst_autotune_draw (sink, offscreen);
+    }
+  clutter_gst_autotune_finish (offscreen);
+
+  timer = g_timer_new ();
+  for (i = 0; i < CLUTTER_GST_AUTOTUNE_FRAMES; i++)
+    {
+      renderer->upload (sink, frame);
+      clutter_gst_autotune_draw (sink, offscreen);
+    }
+  clutter_gst_autotune_finish (offscreen);
+  elapsed = g_timer_elapsed (timer, NULL);
+  g_timer_destroy (timer);
+
+  renderer->deinit (sink);
+  clutter_gst_texture_ring_free (sink);
+  priv->autotuning = FALSE;
+
+  return elapsed;
+}
+
+/* Times every renderer able to display the frames like @buffer and keeps
+ * the fastest. Has to be called from the clutter thread, before the
+ * renderer is initialized */
+static void
+clutter_gst_video_sink_autotune (ClutterGstVideoSink *sink,
+                                 GstBuffer           *buffer)
+{
+  ClutterGstVideoSinkPrivate *priv = sink->priv;
+  ClutterGstRenderer *best = NULL;
+  gdouble best_time = G_MAXDOUBLE;
+  GSList *candidates = NULL, *element;
+  CoglHandle target, offscreen;
+  GstBuffer *frame;
+  gboolean small;
+
+  small = clutter_gst_planar_single_preferred (sink);
+
+  /* there is only one renderer per format able to deinterlace */
+  if (clutter_gst_deinterlace_accept (sink) ||
+      clutter_gst_renderer_registry_get_tuned (priv->registry, priv->format,
+                                               small))
+    return;
+
+  for (element = priv->renderers; element; element = element->next)
+    {
+      ClutterGstRenderer *candidate = element->data;
+
+      /* the fragment program renderers ignore the colour matrix, colour
+       * balance and the colorimetry of the caps would stop working for
+       * good if one of them won and got cached */
+      if ((candidate->flags & CLUTTER_GST_FP) &&
+          (priv->registry->features & CLUTTER_GST_GLSL))
+        continue;
+
+      if (candidate->format == priv->format &&
+          (candidate->accept == NULL || candidate->accept (sink)))
+        candidates = g_slist_prepend (candidates, candidate);
+    }
+
+  /* nothing to choose from, the default choice is as good as it gets */
+  if (candidates == NULL || candidates->next == NULL)
+    {
+      g_slist_free (candidates);
+      return;
+    }
+
+  /* mid grey in both RGB and YUV, the content does not matter much */
+  frame = gst_buffer_new_and_alloc (GST_BUFFER_SIZE (buffer));
+  memset (GST_BUFFER_DATA (frame), 0x80, GST_BUFFER_SIZE (frame));
+  gst_buffer_set_caps (frame, GST_BUFFER_CAPS (buffer));
+
+  target = cogl_texture_new_with_size (priv->width, priv->height,
+                                       CLUTTER_GST_TEXTURE_FLAGS,
+                                       COGL_PIXEL_FORMAT_RGBA_8888_PRE);
+  offscreen = cogl_offscreen_new_to_texture (target);
+
+  for (element = candidates; element; element = element->next)
+    {
+      ClutterGstRenderer *candidate = element->data;
+      gdouble elapsed;
+
+      elapsed = clutter_gst_autotune_time_renderer (sink, candidate,
+                                                    frame, offscreen);
+
+      GST_INFO_OBJECT (sink, "%s renderer: %.3f ms/frame", candidate->name,
+                       elapsed * 1e3 / CLUTTER_GST_AUTOTUNE_FRAMES);
+
+      if (elapsed < best_time)
+        {
+          best = candidate;
+          best_time = elapsed;
+        }
+    }
+
+  cogl_handle_unref (offscreen);
+  cogl_handle_unref (target);
+  gst_buffer_unref (frame);
+  g_slist_free (candidates);
+
+  GST_INFO_OBJECT (sink, "fastest %s renderer: %s",
+                   clutter_gst_video_format_names[priv->format], best->name);
+
+  priv->renderer = best;
+  clutter_gst_renderer_registry_set_tuned (priv->registry, priv->format,
+                                           small, best);
+}
+
+static ClutterGstRenderer *
+clutter_gst_find_renderer_by_format (ClutterGstVideoSink  *sink,
+                                     ClutterGstVideoFormat format)
+{
+  ClutterGstVideoSinkPrivate *priv = sink->priv;
+  ClutterGstRenderer *renderer = NULL, *fallback = NULL;
+  GSList *element;
+  gboolean small;
+
+  if (priv->forced_renderer)
+    {
+      renderer = priv->forced_renderer;
+      if (renderer->format == format &&
+          (renderer->accept == NULL || renderer->accept (sink)))
+        return renderer;
+      return NULL;
+    }
+
+  small = clutter_gst_planar_single_preferred (sink);
+
+  /* the renderer measured as the fastest on this GPU for frames of that
+   * size first, but for frames to deinterlace */
+  if (!clutter_gst_deinterlace_accept (sink))
+    {
+      renderer =
+        clutter_gst_renderer_registry_get_tuned (priv->registry, format,
+                                                 small);
+      if (renderer && (renderer->accept == NULL || renderer->accept (sink)))
+        return renderer;
+      renderer = NULL;
+    }
+
+  for (element = priv->renderers; element; element = g_slist_next(element))
+    {
+      ClutterGstRenderer *candidate = (ClutterGstRenderer *)element->data;
+
+      if (candidate->format != format ||
+          (candidate->accept != NULL && !candidate->accept (sink)))
+        continue;
+
+      /* the single texture renderers trade a longer shader for a single
+       * upload, they are kept for the small frames or for want of
+       * anything else */
+      if (candidate->accept == clutter_gst_planar_single_accept && !small)
+        {
+          if (fallback == NULL)
+            fallback = candidate;
+          continue;
+        }
+
+      renderer = candidate;
+      break;
+    }
+
+  return renderer ? renderer : fallback;
+}
+
+/* Restricts the sink to the renderer called @name, or lets it pick one
+ * again when @name is %NULL */
+static void
+clutter_gst_video_sink_set_renderer (ClutterGstVideoSink *sink,
+                                     const gchar         *name)
 {
   ClutterGstVideoSinkPrivate *priv = sink->priv;
   ClutterGstRenderer *renderer = NULL;
   GSList *element;
 
-  for (element = priv->renderers; element; element = g_slist_next(element))
+  if (name)
     {
-      ClutterGstRenderer *candidate = (ClutterGstRenderer *)element->data;
+      for (element = priv->renderers; element; element = element->next)
+        {
+          ClutterGstRenderer *candidate = element->data;
+
+          if (strcmp (candidate->name, name) == 0)
+            {
+              renderer = candidate;
+              break;
+            }
+        }
 
-      if (candidate->format == format)
+      if (renderer == NULL)
         {
-          renderer = candidate;
-          break;
+          GST_WARNING_OBJECT (sink, "no %s renderer with this GL context",
+                              name);
+          return;
         }
     }
 
-  return renderer;
+  priv->forced_renderer = renderer;
+  gst_caps_unref (priv->caps);
+  if (renderer)
+    priv->caps = gst_static_caps_get (&renderer->caps);
+  else
+    priv->caps = gst_caps_ref (priv->registry->caps);
 }
 
 static void
@@ -916,6 +3730,9 @@ navigation_event (ClutterActor        *actor,
                   ClutterEvent        *event,
                   ClutterGstVideoSink *sink)
 {
+  /* the coordinates are relative to whichever texture got the event */
+  sink->priv->input_actor = actor;
+
   if (event->type == CLUTTER_MOTION)
     {
       ClutterMotionEvent *mevent = (ClutterMotionEvent *) event;
@@ -966,11 +3783,14 @@ navigation_event (ClutterActor        *actor,
       if (command != GST_NAVIGATION_COMMAND_INVALID)
         {
           gst_navigation_send_command (GST_NAVIGATION (sink), command);
+          sink->priv->input_actor = NULL;
 
           return TRUE;
         }
     }
 
+  sink->priv->input_actor = NULL;
+
   return FALSE;
 }
 
@@ -979,6 +3799,7 @@ clutter_gst_video_sink_init (ClutterGstVideoSink      *sink,
                              ClutterGstVideoSinkClass *klass)
 {
   ClutterGstVideoSinkPrivate *priv;
+  guint i;
 
   sink->priv = priv =
     G_TYPE_INSTANCE_GET_PRIVATE (sink, CLUTTER_GST_TYPE_VIDEO_SINK,
@@ -988,11 +3809,100 @@ clutter_gst_video_sink_init (ClutterGstVideoSink      *sink,
    * the clutter thread)  */
   priv->clutter_main_context = g_main_context_default ();
 
-  priv->renderers = clutter_gst_build_renderers_list ();
-  priv->caps = clutter_gst_build_caps (priv->renderers);
+  priv->registry = clutter_gst_renderer_registry_get ();
+  priv->renderers = priv->registry->renderers;
+  priv->caps = gst_caps_ref (priv->registry->caps);
   priv->renderer_state = CLUTTER_GST_RENDERER_STOPPED;
 
   priv->signal_handler_ids = g_array_new (FALSE, TRUE, sizeof (gulong));
+
+  for (i = 0; i < CLUTTER_GST_N_BALANCE_CHANNELS; i++)
+    {
+      GstColorBalanceChannel *channel;
+
+      channel = g_object_new (GST_TYPE_COLOR_BALANCE_CHANNEL, NULL);
+      channel->label = g_strdup (clutter_gst_balance_channel_names[i]);
+      channel->min_value = CLUTTER_GST_BALANCE_MIN;
+      channel->max_value = CLUTTER_GST_BALANCE_MAX;
+
+      priv->balance_channels = g_list_append (priv->balance_channels, channel);
+    }
+  priv->yuv_matrix_dirty = TRUE;
+  priv->yuv_matrix_location = -1;
+  priv->field_location = priv->height_location = -1;
+  priv->scale = 1;
+
+  priv->frame_painted = TRUE;
+  priv->stats_lock = g_mutex_new ();
+  priv->stats_timer = g_timer_new ();
+
+  priv->trace_latency = CLUTTER_GST_DEBUG_ENABLED (LATENCY) != 0;
+  priv->trace_lock = g_mutex_new ();
+  priv->stage_lock = g_mutex_new ();
+  priv->stage_cond = g_cond_new ();
+  clutter_gst_frame_timing_init (&priv->timing);
+
+  priv->pool =
+    clutter_gst_buffer_pool_new (CLUTTER_GST_DEFAULT_BUFFER_POOL_SIZE);
+}
+
+/* Sends a QoS event upstream claiming we are one frame late for @buffer */
+static void
+clutter_gst_video_sink_send_skip_hint (ClutterGstVideoSink *sink,
+                                       GstBuffer           *buffer)
+{
+  ClutterGstVideoSinkPrivate *priv = sink->priv;
+  GstBaseSink *bsink = GST_BASE_SINK (sink);
+  GstClockTime timestamp, duration;
+  GstEvent *event;
+
+  timestamp = GST_BUFFER_TIMESTAMP (buffer);
+  if (!GST_CLOCK_TIME_IS_VALID (timestamp))
+    return;
+
+  timestamp = gst_segment_to_running_time (&bsink->segment,
+                                           GST_FORMAT_TIME, timestamp);
+  if (!GST_CLOCK_TIME_IS_VALID (timestamp))
+    return;
+
+  duration = GST_BUFFER_DURATION (buffer);
+  if (!GST_CLOCK_TIME_IS_VALID (duration))
+    {
+      if (priv->fps_n > 0)
+        duration = gst_util_uint64_scale_int (GST_SECOND,
+                                              priv->fps_d, priv->fps_n);
+      else
+        duration = 40 * GST_MSECOND;
+    }
+
+  event = gst_event_new_qos (2.0, duration, timestamp);
+  gst_pad_push_event (GST_BASE_SINK_PAD (bsink), event);
+}
+
+/* Hands @buffer to the clutter thread along with its timing */
+static void
+clutter_gst_video_sink_push_traced (ClutterGstVideoSink *sink,
+                                    GstBuffer           *buffer)
+{
+  ClutterGstVideoSinkPrivate *priv = sink->priv;
+  ClutterGstFrameTiming *timing = &priv->render_timing;
+  GstBaseSink *bsink = GST_BASE_SINK (sink);
+
+  g_mutex_lock (priv->trace_lock);
+
+  clutter_gst_frame_timing_init (timing);
+  timing->timestamp = GST_BUFFER_TIMESTAMP (buffer);
+  if (GST_CLOCK_TIME_IS_VALID (timing->timestamp))
+    timing->running_time = gst_segment_to_running_time (&bsink->segment,
+                                                        GST_FORMAT_TIME,
+                                                        timing->timestamp);
+  timing->render = gst_util_get_timestamp ();
+
+  /* only compared with the buffer the clutter thread picks up */
+  priv->render_buffer = buffer;
+  clutter_gst_source_push (priv->source, buffer);
+
+  g_mutex_unlock (priv->trace_lock);
 }
 
 static GstFlowReturn
@@ -1001,7 +3911,287 @@ clutter_gst_video_sink_render (GstBaseSink *bsink,
 {
   ClutterGstVideoSink *sink = CLUTTER_GST_VIDEO_SINK (bsink);
 
-  clutter_gst_source_push (sink->priv->source, buffer);
+  /* the base sink renders the prerolled buffer again once playing, it has
+   * already been counted */
+  if (buffer == sink->priv->prerolled_buffer)
+    sink->priv->prerolled_buffer = NULL;
+  else
+    g_atomic_int_inc (&sink->priv->frames_received);
+
+  /* the planes are read straight from the buffer, don't read past it */
+  if (G_UNLIKELY (GST_BUFFER_SIZE (buffer) < sink->priv->frame_size))
+    {
+      GST_WARNING_OBJECT (sink, "buffer too small (%u bytes) for the "
+                          "negotiated frames (%" G_GSIZE_FORMAT " bytes)",
+                          GST_BUFFER_SIZE (buffer), sink->priv->frame_size);
+      g_atomic_int_inc (&sink->priv->dropped_frames);
+      return GST_FLOW_OK;
+    }
+
+  /* nobody will see this frame, tell upstream we are late so that
+   * decoders skip the frames they can skip (the non-reference ones) */
+  if (g_atomic_int_get (&sink->priv->hidden))
+    clutter_gst_video_sink_send_skip_hint (sink, buffer);
+  else
+    clutter_gst_video_sink_stage (sink, buffer);
+
+  if (G_UNLIKELY (sink->priv->trace_latency))
+    clutter_gst_video_sink_push_traced (sink, buffer);
+  else
+    clutter_gst_source_push (sink->priv->source, buffer);
+
+  return GST_FLOW_OK;
+}
+
+static GstFlowReturn
+clutter_gst_video_sink_preroll (GstBaseSink *bsink,
+                                GstBuffer   *buffer)
+{
+  ClutterGstVideoSink *sink = CLUTTER_GST_VIDEO_SINK (bsink);
+  GstFlowReturn ret;
+
+  sink->priv->prerolled_buffer = NULL;
+  ret = clutter_gst_video_sink_render (bsink, buffer);
+  sink->priv->prerolled_buffer = buffer;
+
+  return ret;
+}
+
+/*
+ * Downscaling
+ *
+ * When the texture is shown a lot smaller than the frames, there's no point
+ * in decoding, uploading and sampling full size frames. Once the allocation
+ * of the texture has been stable for a little while, the clutter thread
+ * works out the power of two by which the frames can be divided while
+ * still being at least as big as the texture, and the streaming thread asks
+ * upstream for such frames by handing out buffers with the smaller caps in
+ * buffer_alloc(), the way other 0.10 video sinks renegotiate. Elements that
+ * can't produce smaller frames (no lowres decoding nor videoscale in front
+ * of the sink) refuse the caps and nothing changes.
+ *
+ * Powers of two are what decoders supporting lowres decoding produce
+ * cheaply, and, with the delay and the margin below, keep animations of
+ * the size of the texture from renegotiating at every frame.
+ */
+
+#define CLUTTER_GST_DOWNSCALE_DELAY   500   /* ms */
+#define CLUTTER_GST_DOWNSCALE_MARGIN  1.25
+#define CLUTTER_GST_MAX_SCALE         8
+
+static gint
+clutter_gst_video_sink_compute_scale (ClutterGstVideoSink *sink,
+                                      gfloat               alloc_width,
+                                      gfloat               alloc_height)
+{
+  ClutterGstVideoSinkPrivate *priv = sink->priv;
+  gint native_width, native_height, scale;
+
+  native_width = g_atomic_int_get (&priv->native_width);
+  native_height = g_atomic_int_get (&priv->native_height);
+  scale = g_atomic_int_get (&priv->scale);
+
+  if (priv->downscale_threshold <= 0 || native_width == 0 ||
+      native_height == 0 || alloc_width < 1 || alloc_height < 1)
+    return 1;
+
+  /* not worth it */
+  if (native_width < alloc_width * priv->downscale_threshold &&
+      native_height < alloc_height * priv->downscale_threshold)
+    return 1;
+
+  /* never show frames smaller than the texture, scale back up right away */
+  while (scale > 1 &&
+         (native_width / scale < alloc_width ||
+          native_height / scale < alloc_height))
+    scale /= 2;
+
+  /* but only scale down once the next step has some margin, so that small
+   * size changes around a step don't renegotiate back and forth */
+  while (scale < CLUTTER_GST_MAX_SCALE &&
+         native_width / (scale * 2) >=
+           alloc_width * CLUTTER_GST_DOWNSCALE_MARGIN &&
+         native_height / (scale * 2) >=
+           alloc_height * CLUTTER_GST_DOWNSCALE_MARGIN)
+    scale *= 2;
+
+  return scale;
+}
+
+static void
+clutter_gst_video_sink_cancel_downscale (ClutterGstVideoSink *sink)
+{
+  ClutterGstVideoSinkPrivate *priv = sink->priv;
+
+  if (priv->downscale_timeout)
+    {
+      g_source_destroy (priv->downscale_timeout);
+      g_source_unref (priv->downscale_timeout);
+      priv->downscale_timeout = NULL;
+    }
+}
+
+static gboolean
+clutter_gst_video_sink_update_scale (gpointer data)
+{
+  ClutterGstVideoSink *sink = CLUTTER_GST_VIDEO_SINK (data);
+  ClutterGstVideoSinkPrivate *priv = sink->priv;
+  gfloat width, height, view_width, view_height;
+  GSList *l;
+  gint scale;
+
+  g_source_unref (priv->downscale_timeout);
+  priv->downscale_timeout = NULL;
+
+  if (priv->texture == NULL)
+    return FALSE;
+
+  /* the frames have to be good enough for the biggest texture */
+  clutter_actor_get_size (CLUTTER_ACTOR (priv->texture), &width, &height);
+  for (l = priv->textures; l; l = l->next)
+    {
+      clutter_actor_get_size (CLUTTER_ACTOR (l->data),
+                              &view_width, &view_height);
+      width = MAX (width, view_width);
+      height = MAX (height, view_height);
+    }
+
+  scale = clutter_gst_video_sink_compute_scale (sink, width, height);
+
+  if (scale != g_atomic_int_get (&priv->scale))
+    {
+      GST_DEBUG_OBJECT (sink, "texture is %.0fx%.0f, asking for frames "
+                        "scaled down by %d", width, height, scale);
+      g_atomic_int_set (&priv->scale, scale);
+    }
+
+  return FALSE;
+}
+
+static void
+on_texture_allocation_changed (ClutterActor           *actor,
+                               const ClutterActorBox  *box,
+                               ClutterAllocationFlags  flags,
+                               gpointer                user_data)
+{
+  ClutterGstVideoSink *sink = CLUTTER_GST_VIDEO_SINK (user_data);
+  ClutterGstVideoSinkPrivate *priv = sink->priv;
+
+  if (priv->downscale_threshold <= 0)
+    return;
+
+  /* wait for the size to settle */
+  clutter_gst_video_sink_cancel_downscale (sink);
+  priv->downscale_timeout = g_timeout_source_new (CLUTTER_GST_DOWNSCALE_DELAY);
+  g_source_set_callback (priv->downscale_timeout,
+                         clutter_gst_video_sink_update_scale, sink, NULL);
+  g_source_attach (priv->downscale_timeout, priv->clutter_main_context);
+}
+
+/* Returns the caps upstream should switch to in place of @caps, or NULL
+ * when @caps are fine, and the size of the frames with those caps in
+ * @size. Called from the streaming thread */
+static GstCaps *
+clutter_gst_video_sink_get_scaled_caps (ClutterGstVideoSink *sink,
+                                        GstCaps             *caps,
+                                        guint               *size)
+{
+  ClutterGstVideoSinkPrivate *priv = sink->priv;
+  GstStructure *structure;
+  GstVideoFormat format;
+  GstCaps *scaled_caps;
+  gint native_width, native_height, scale, width, height;
+
+  native_width = g_atomic_int_get (&priv->native_width);
+  native_height = g_atomic_int_get (&priv->native_height);
+  scale = g_atomic_int_get (&priv->scale);
+
+  if (native_width == 0 || native_height == 0 ||
+      !gst_video_format_parse_caps (caps, &format, &width, &height))
+    return NULL;
+
+  /* keep the size even, for the chroma planes of 4:2:0 frames */
+  if (scale > 1)
+    {
+      native_width = MAX (2, (native_width / scale) & ~1);
+      native_height = MAX (2, (native_height / scale) & ~1);
+    }
+
+  if (width == native_width && height == native_height)
+    return NULL;
+
+  scaled_caps = gst_caps_copy (caps);
+  structure = gst_caps_get_structure (scaled_caps, 0);
+  gst_structure_set (structure,
+                     "width", G_TYPE_INT, native_width,
+                     "height", G_TYPE_INT, native_height,
+                     NULL);
+
+  if (!gst_pad_peer_accept_caps (GST_BASE_SINK_PAD (sink), scaled_caps))
+    {
+      GST_LOG_OBJECT (sink, "upstream can't produce %dx%d frames",
+                      native_width, native_height);
+      gst_caps_unref (scaled_caps);
+      return NULL;
+    }
+
+  GST_DEBUG_OBJECT (sink, "renegotiating from %dx%d to %dx%d",
+                    width, height, native_width, native_height);
+
+  priv->scaled_width = native_width;
+  priv->scaled_height = native_height;
+  *size = gst_video_format_get_size (format, native_width, native_height);
+
+  return scaled_caps;
+}
+
+static GstFlowReturn
+clutter_gst_video_sink_buffer_alloc (GstBaseSink  *bsink,
+                                     guint64       offset,
+                                     guint         size,
+                                     GstCaps      *caps,
+                                     GstBuffer   **buf)
+{
+  ClutterGstVideoSink *sink = CLUTTER_GST_VIDEO_SINK (bsink);
+  ClutterGstVideoSinkPrivate *priv = sink->priv;
+  GstCaps *scaled_caps = NULL;
+
+  *buf = NULL;
+
+  if (caps && priv->downscale_threshold > 0)
+    scaled_caps = clutter_gst_video_sink_get_scaled_caps (sink, caps, &size);
+
+  /* Returning no buffer makes the pad fall back to a plain malloc'ed
+   * buffer. Do that when pooling is disabled or for caps we can't render
+   * anyway */
+  if (priv->pool->max_free == 0 && scaled_caps == NULL)
+    return GST_FLOW_OK;
+
+  if (scaled_caps)
+    {
+      /* a buffer with other caps than the ones asked for tells upstream to
+       * renegotiate */
+      if (priv->pool->max_free == 0)
+        *buf = gst_buffer_new_and_alloc (size);
+      else
+        *buf = clutter_gst_buffer_pool_acquire (priv->pool, size);
+      GST_BUFFER_OFFSET (*buf) = offset;
+      gst_buffer_set_caps (*buf, scaled_caps);
+      gst_caps_unref (scaled_caps);
+
+      return GST_FLOW_OK;
+    }
+
+  if (caps == NULL || !gst_caps_can_intersect (priv->caps, caps))
+    {
+      GST_DEBUG_OBJECT (sink, "not pooling buffers for caps %" GST_PTR_FORMAT,
+                        caps);
+      return GST_FLOW_OK;
+    }
+
+  *buf = clutter_gst_buffer_pool_acquire (priv->pool, size);
+  GST_BUFFER_OFFSET (*buf) = offset;
+  gst_buffer_set_caps (*buf, caps);
 
   return GST_FLOW_OK;
 }
@@ -1015,6 +4205,109 @@ clutter_gst_video_sink_get_caps (GstBaseSink *bsink)
   return gst_caps_ref (sink->priv->caps);
 }
 
+/* Works out where the planes are in the frames and how they are laid out
+ * in memory (row stride and padding), as described by the video library for
+ * the negotiated format. The planes are listed in the order the renderers
+ * bind them to texture layers */
+static gboolean
+clutter_gst_video_sink_setup_planes (ClutterGstVideoSink *sink,
+                                     GstVideoFormat       video_format)
+{
+  ClutterGstVideoSinkPrivate *priv = sink->priv;
+  ClutterGstPlane *planes = priv->planes;
+  gint width = priv->width, height = priv->height;
+  gint first, second, i;
+
+  memset (planes, 0, sizeof (priv->planes));
+
+  switch (priv->format)
+    {
+    case CLUTTER_GST_RGB24:
+    case CLUTTER_GST_RGB32:
+    case CLUTTER_GST_AYUV:
+      priv->n_planes = 1;
+      planes[0].rowstride = gst_video_format_get_row_stride (video_format,
+                                                             0, width);
+      planes[0].width = width;
+      planes[0].height = height;
+      break;
+
+    case CLUTTER_GST_YUY2:
+    case CLUTTER_GST_UYVY:
+      /* one RGBA texel per macropixel */
+      priv->n_planes = 1;
+      planes[0].rowstride = gst_video_format_get_row_stride (video_format,
+                                                             0, width);
+      planes[0].width = GST_ROUND_UP_2 (width) / 2;
+      planes[0].height = height;
+      break;
+
+    case CLUTTER_GST_YV12:
+    case CLUTTER_GST_I420:
+      /* the chroma planes are bound in the order they appear in memory */
+      priv->n_planes = 3;
+      if (gst_video_format_get_component_offset (video_format, 1,
+                                                 width, height) <
+          gst_video_format_get_component_offset (video_format, 2,
+                                                 width, height))
+        first = 1, second = 2;
+      else
+        first = 2, second = 1;
+
+      for (i = 0; i < 3; i++)
+        {
+          gint component = (i == 0) ? 0 : (i == 1) ? first : second;
+
+          planes[i].offset =
+            gst_video_format_get_component_offset (video_format, component,
+                                                   width, height);
+          planes[i].rowstride =
+            gst_video_format_get_row_stride (video_format, component, width);
+          planes[i].width =
+            gst_video_format_get_component_width (video_format, component,
+                                                  width);
+          planes[i].height =
+            gst_video_format_get_component_height (video_format, component,
+                                                   height);
+        }
+      break;
+
+    case CLUTTER_GST_NV12:
+    case CLUTTER_GST_NV21:
+      /* the interleaved chroma plane is a texture of single bytes */
+      priv->n_planes = 2;
+      planes[0].rowstride = gst_video_format_get_row_stride (video_format,
+                                                             0, width);
+      planes[0].width = width;
+      planes[0].height = height;
+
+      planes[1].offset =
+        MIN (gst_video_format_get_component_offset (video_format, 1,
+                                                    width, height),
+             gst_video_format_get_component_offset (video_format, 2,
+                                                    width, height));
+      planes[1].rowstride = gst_video_format_get_row_stride (video_format,
+                                                             1, width);
+      planes[1].width =
+        2 * gst_video_format_get_component_width (video_format, 1, width);
+      planes[1].height =
+        gst_video_format_get_component_height (video_format, 1, height);
+      break;
+
+    default:
+      return FALSE;
+    }
+
+  priv->frame_size = gst_video_format_get_size (video_format, width, height);
+
+  for (i = 0; i < priv->n_planes; i++)
+    GST_DEBUG_OBJECT (sink, "plane %d: offset %" G_GSIZE_FORMAT ", stride %d, "
+                      "%dx%d", i, planes[i].offset, planes[i].rowstride,
+                      planes[i].width, planes[i].height);
+
+  return TRUE;
+}
+
 static gboolean
 clutter_gst_video_sink_set_caps (GstBaseSink *bsink,
                                  GstCaps     *caps)
@@ -1027,8 +4320,12 @@ clutter_gst_video_sink_set_caps (GstBaseSink *bsink,
   const GValue               *fps;
   const GValue               *par;
   gint                        width, height;
+  const gchar                *color_matrix;
+  gboolean                    interlaced;
   guint32                     fourcc;
   int                         red_mask, blue_mask;
+  GstVideoFormat              video_format;
+  ClutterGstRenderer         *renderer;
 
   sink = CLUTTER_GST_VIDEO_SINK(bsink);
   priv = sink->priv;
@@ -1054,6 +4351,15 @@ clutter_gst_video_sink_set_caps (GstBaseSink *bsink,
   priv->width  = width;
   priv->height = height;
 
+  /* not a size we asked for, that's what upstream produces on its own */
+  if (width != priv->scaled_width || height != priv->scaled_height)
+    {
+      g_atomic_int_set (&priv->native_width, width);
+      g_atomic_int_set (&priv->native_height, height);
+      priv->scaled_width = width;
+      priv->scaled_height = height;
+    }
+
   /* We dont yet use fps or pixel aspect into but handy to have */
   priv->fps_n  = gst_value_get_fraction_numerator (fps);
   priv->fps_d  = gst_value_get_fraction_denominator (fps);
@@ -1066,16 +4372,15 @@ clutter_gst_video_sink_set_caps (GstBaseSink *bsink,
   else
     priv->par_n = priv->par_d = 1;
 
-  /* If we happen to use a ClutterGstVideoTexture, now is to good time to
-   * instruct it about the pixel aspect ratio so we can have a correct
-   * natural width/height */
-  if (CLUTTER_GST_IS_VIDEO_TEXTURE (priv->texture))
-    {
-      ClutterGstVideoTexture *texture =
-        (ClutterGstVideoTexture *) priv->texture;
+  interlaced = FALSE;
+  gst_structure_get_boolean (structure, "interlaced", &interlaced);
+  priv->interlaced = interlaced;
 
-      _clutter_gst_video_texture_set_par (texture, priv->par_n, priv->par_d);
-    }
+  /* "sdtv" (BT.601) is what GStreamer assumes when not told otherwise */
+  color_matrix = gst_structure_get_string (structure, "color-matrix");
+  g_atomic_int_set (&priv->hdtv,
+                    color_matrix && strcmp (color_matrix, "hdtv") == 0);
+  g_atomic_int_set (&priv->yuv_matrix_dirty, TRUE);
 
   ret = gst_structure_get_fourcc (structure, "format", &fourcc);
   if (ret && (fourcc == GST_MAKE_FOURCC ('Y', 'V', '1', '2')))
@@ -1086,6 +4391,22 @@ clutter_gst_video_sink_set_caps (GstBaseSink *bsink,
     {
       priv->format = CLUTTER_GST_I420;
     }
+  else if (ret && (fourcc == GST_MAKE_FOURCC ('N', 'V', '1', '2')))
+    {
+      priv->format = CLUTTER_GST_NV12;
+    }
+  else if (ret && (fourcc == GST_MAKE_FOURCC ('N', 'V', '2', '1')))
+    {
+      priv->format = CLUTTER_GST_NV21;
+    }
+  else if (ret && (fourcc == GST_MAKE_FOURCC ('Y', 'U', 'Y', '2')))
+    {
+      priv->format = CLUTTER_GST_YUY2;
+    }
+  else if (ret && (fourcc == GST_MAKE_FOURCC ('U', 'Y', 'V', 'Y')))
+    {
+      priv->format = CLUTTER_GST_UYVY;
+    }
   else if (ret && (fourcc == GST_MAKE_FOURCC ('A', 'Y', 'U', 'V')))
     {
       priv->format = CLUTTER_GST_AYUV;
@@ -1110,19 +4431,59 @@ clutter_gst_video_sink_set_caps (GstBaseSink *bsink,
         }
     }
 
+  if (!gst_video_format_parse_caps (caps, &video_format, NULL, NULL) ||
+      !clutter_gst_video_sink_setup_planes (sink, video_format))
+    {
+      GST_ERROR_OBJECT (sink, "could not work out the layout of the frames");
+      return FALSE;
+    }
+
+  /* the other textures are told along with the next frame, the list can
+   * only be walked from the clutter thread */
+  clutter_gst_video_sink_set_par (sink, priv->texture);
+  g_atomic_int_set (&priv->textures_par_dirty, TRUE);
+
   /* find a renderer that can display our format */
-  priv->renderer = clutter_gst_find_renderer_by_format (sink, priv->format);
-  if (G_UNLIKELY (priv->renderer == NULL))
+  renderer = clutter_gst_find_renderer_by_format (sink, priv->format);
+  if (G_UNLIKELY (renderer == NULL))
     {
       GST_ERROR_OBJECT (sink, "could not find a suitable renderer");
       return FALSE;
     }
 
+  /* the new renderer has to be set up in the clutter thread */
+  if (priv->renderer != renderer &&
+      priv->renderer_state == CLUTTER_GST_RENDERER_RUNNING)
+    priv->renderer_state = CLUTTER_GST_RENDERER_NEED_GC;
+  priv->renderer = renderer;
+
   GST_INFO_OBJECT (sink, "using the %s renderer", priv->renderer->name);
 
   return TRUE;
 }
 
+/* The formats of the renderers able to deinterlace */
+static GstCaps *
+clutter_gst_video_sink_get_deinterlace_caps (ClutterGstVideoSink *sink)
+{
+  GstCaps *caps;
+  GSList *element;
+
+  caps = gst_caps_new_empty ();
+
+  for (element = sink->priv->renderers; element; element = element->next)
+    {
+      ClutterGstRenderer *renderer = element->data;
+
+      if (renderer->accept == clutter_gst_deinterlace_accept)
+        gst_caps_append (caps,
+                         gst_caps_make_writable (
+                           gst_static_caps_get (&renderer->caps)));
+    }
+
+  return caps;
+}
+
 static void
 clutter_gst_video_sink_dispose (GObject *object)
 {
@@ -1139,9 +4500,16 @@ clutter_gst_video_sink_dispose (GObject *object)
       priv->renderer_state = CLUTTER_GST_RENDERER_STOPPED;
     }
 
+  clutter_gst_texture_ring_free (self);
+
+  while (priv->textures)
+    clutter_gst_video_sink_remove_texture (self, priv->textures->data);
+
   if (priv->texture)
     clutter_gst_video_sink_set_texture (self, NULL);
 
+  clutter_gst_video_sink_cancel_downscale (self);
+
   if (priv->caps)
     {
       gst_caps_unref (priv->caps);
@@ -1160,16 +4528,34 @@ clutter_gst_video_sink_finalize (GObject *object)
   self = CLUTTER_GST_VIDEO_SINK (object);
   priv = self->priv;
 
-  g_slist_free (priv->renderers);
+  g_free (priv->program_source);
+
+  clutter_gst_renderer_registry_unref (priv->registry);
+
+  g_list_foreach (priv->balance_channels, (GFunc) g_object_unref, NULL);
+  g_list_free (priv->balance_channels);
 
   g_array_free (priv->signal_handler_ids, TRUE);
 
+  g_timer_destroy (priv->stats_timer);
+  g_mutex_free (priv->stats_lock);
+  g_mutex_free (priv->trace_lock);
+  g_mutex_free (priv->stage_lock);
+  g_cond_free (priv->stage_cond);
+
+  /* buffers still alive upstream keep the pool around until they are
+   * freed */
+  clutter_gst_buffer_pool_unref (priv->pool);
+
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
+/* Connects the handlers the sink needs on a texture showing its frames,
+ * appending their ids to @ids when not NULL */
 static void
-clutter_gst_video_sink_set_texture (ClutterGstVideoSink *sink,
-                                    ClutterTexture      *texture)
+clutter_gst_video_sink_connect_texture (ClutterGstVideoSink *sink,
+                                        ClutterTexture      *texture,
+                                        GArray              *ids)
 {
   const char const *events[] = {
     "key-press-event",
@@ -1178,6 +4564,48 @@ clutter_gst_video_sink_set_texture (ClutterGstVideoSink *sink,
     "button-release-event",
     "motion-event"
   };
+  const char *visibility_notifies[] = {
+    "notify::mapped",
+    "notify::opacity"
+  };
+  gulong id;
+  guint i;
+
+  clutter_actor_set_reactive (CLUTTER_ACTOR (texture), TRUE);
+
+  for (i = 0; i < G_N_ELEMENTS (events); i++)
+    {
+      id = g_signal_connect (texture, events[i],
+                             G_CALLBACK (navigation_event), sink);
+      if (ids)
+        g_array_append_val (ids, id);
+    }
+
+  for (i = 0; i < G_N_ELEMENTS (visibility_notifies); i++)
+    {
+      id = g_signal_connect (texture, visibility_notifies[i],
+                             G_CALLBACK (on_texture_visibility_changed), sink);
+      if (ids)
+        g_array_append_val (ids, id);
+    }
+
+  /* the textures share the GL program, each of them needs the uniforms of
+   * the sink set before being painted */
+  id = g_signal_connect (texture, "paint",
+                         G_CALLBACK (on_texture_paint), sink);
+  if (ids)
+    g_array_append_val (ids, id);
+
+  id = g_signal_connect (texture, "allocation-changed",
+                         G_CALLBACK (on_texture_allocation_changed), sink);
+  if (ids)
+    g_array_append_val (ids, id);
+}
+
+static void
+clutter_gst_video_sink_set_texture (ClutterGstVideoSink *sink,
+                                    ClutterTexture      *texture)
+{
   ClutterGstVideoSinkPrivate *priv = sink->priv;
   guint i;
 
@@ -1191,20 +4619,31 @@ clutter_gst_video_sink_set_texture (ClutterGstVideoSink *sink,
       g_array_set_size (priv->signal_handler_ids, 0);
     }
 
+  clutter_gst_video_sink_cancel_downscale (sink);
+
+  /* start over assuming the new texture is visible, the next repaint will
+   * tell */
+  if (g_atomic_int_get (&priv->hidden))
+    {
+      g_atomic_int_set (&priv->hidden, FALSE);
+      gst_base_sink_set_qos_enabled (GST_BASE_SINK (sink), priv->qos_enabled);
+    }
+
   priv->texture = texture;
   if (priv->texture == NULL)
     return;
 
-  clutter_actor_set_reactive (CLUTTER_ACTOR (priv->texture), TRUE);
   g_object_add_weak_pointer (G_OBJECT (priv->texture), (gpointer *) &(priv->texture));
 
-  for (i = 0; i < G_N_ELEMENTS (events); i++)
-    {
-      gulong id;
-      id = g_signal_connect (priv->texture, events[i],
-                             G_CALLBACK (navigation_event), sink);
-      g_array_append_val (priv->signal_handler_ids, id);
-    }
+  clutter_gst_video_sink_connect_texture (sink, priv->texture,
+                                          priv->signal_handler_ids);
+}
+
+static void
+on_extra_texture_destroy (ClutterActor        *actor,
+                          ClutterGstVideoSink *sink)
+{
+  clutter_gst_video_sink_remove_texture (sink, CLUTTER_TEXTURE (actor));
 }
 
 static void
@@ -1220,8 +4659,38 @@ clutter_gst_video_sink_set_property (GObject *object,
     case PROP_TEXTURE:
       clutter_gst_video_sink_set_texture (sink, g_value_get_object (value));
       break;
-    case PROP_UPDATE_PRIORITY:
-      clutter_gst_video_sink_set_priority (sink, g_value_get_int (value));
+    case PROP_UPDATE_PRIORITY:
+      clutter_gst_video_sink_set_priority (sink, g_value_get_int (value));
+      break;
+    case PROP_BUFFER_POOL_SIZE:
+      clutter_gst_buffer_pool_set_max_free (sink->priv->pool,
+                                            g_value_get_uint (value));
+      break;
+    case PROP_USE_PIXEL_BUFFERS:
+      sink->priv->use_pbo = g_value_get_boolean (value);
+      break;
+    case PROP_UPLOAD_ON_PAINT:
+      sink->priv->upload_on_paint = g_value_get_boolean (value);
+      break;
+    case PROP_DEINTERLACE_MODE:
+      sink->priv->deinterlace_mode = g_value_get_enum (value);
+      break;
+    case PROP_DEINTERLACE_DOUBLE_RATE:
+      sink->priv->deinterlace_double_rate = g_value_get_boolean (value);
+      break;
+    case PROP_DOWNSCALE_THRESHOLD:
+      sink->priv->downscale_threshold = g_value_get_double (value);
+      if (sink->priv->downscale_threshold <= 0)
+        g_atomic_int_set (&sink->priv->scale, 1);
+      break;
+    case PROP_STATS_INTERVAL:
+      sink->priv->stats_interval = g_value_get_uint (value);
+      break;
+    case PROP_TRACE_LATENCY:
+      sink->priv->trace_latency = g_value_get_boolean (value);
+      break;
+    case PROP_RENDERER:
+      clutter_gst_video_sink_set_renderer (sink, g_value_get_string (value));
       break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
@@ -1246,12 +4715,84 @@ clutter_gst_video_sink_get_property (GObject *object,
     case PROP_UPDATE_PRIORITY:
       g_value_set_int (value, g_source_get_priority ((GSource *) priv->source));
       break;
+    case PROP_BUFFER_POOL_SIZE:
+      g_value_set_uint (value, priv->pool->max_free);
+      break;
+    case PROP_BUFFER_POOL_STATS:
+      g_value_take_boxed (value,
+                          clutter_gst_buffer_pool_get_stats (priv->pool));
+      break;
+    case PROP_USE_PIXEL_BUFFERS:
+      g_value_set_boolean (value, priv->use_pbo);
+      break;
+    case PROP_UPLOAD_ON_PAINT:
+      g_value_set_boolean (value, priv->upload_on_paint);
+      break;
+    case PROP_DEINTERLACE_MODE:
+      g_value_set_enum (value, priv->deinterlace_mode);
+      break;
+    case PROP_DEINTERLACE_DOUBLE_RATE:
+      g_value_set_boolean (value, priv->deinterlace_double_rate);
+      break;
+    case PROP_DEINTERLACE_CAPS:
+      g_value_take_boxed (value,
+                          clutter_gst_video_sink_get_deinterlace_caps (sink));
+      break;
+    case PROP_DOWNSCALE_THRESHOLD:
+      g_value_set_double (value, priv->downscale_threshold);
+      break;
+    case PROP_STATS:
+      g_value_take_boxed (value, clutter_gst_video_sink_get_stats (sink));
+      break;
+    case PROP_STATS_INTERVAL:
+      g_value_set_uint (value, priv->stats_interval);
+      break;
+    case PROP_TRACE_LATENCY:
+      g_value_set_boolean (value, priv->trace_latency);
+      break;
+    case PROP_RENDERER:
+      if (priv->forced_renderer)
+        g_value_set_string (value, priv->forced_renderer->name);
+      else if (priv->renderer)
+        g_value_set_string (value, priv->renderer->name);
+      else
+        g_value_set_string (value, NULL);
+      break;
+    case PROP_RENDERERS:
+      {
+        gchar **names;
+        GSList *element;
+        guint i = 0;
+
+        names = g_new0 (gchar *, g_slist_length (priv->renderers) + 1);
+        for (element = priv->renderers; element; element = element->next)
+          {
+            ClutterGstRenderer *renderer = element->data;
+
+            names[i++] = g_strdup (renderer->name);
+          }
+        g_value_take_boxed (value, names);
+      }
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
   }
 }
 
+static gboolean
+clutter_gst_video_sink_post_stats (gpointer data)
+{
+  ClutterGstVideoSink *sink = CLUTTER_GST_VIDEO_SINK (data);
+  GstMessage *message;
+
+  message = gst_message_new_element (GST_OBJECT (sink),
+                                     clutter_gst_video_sink_get_stats (sink));
+  gst_element_post_message (GST_ELEMENT (sink), message);
+
+  return TRUE;
+}
+
 static gboolean
 clutter_gst_video_sink_start (GstBaseSink *base_sink)
 {
@@ -1261,6 +4802,19 @@ clutter_gst_video_sink_start (GstBaseSink *base_sink)
   priv->source = clutter_gst_source_new (sink);
   g_source_attach ((GSource *) priv->source, priv->clutter_main_context);
 
+  priv->repaint_func_id =
+    clutter_threads_add_repaint_func (clutter_gst_video_sink_repaint_func,
+                                      sink, NULL);
+
+  clutter_gst_video_sink_reset_stats (sink);
+  if (priv->stats_interval)
+    {
+      priv->stats_source = g_timeout_source_new (priv->stats_interval);
+      g_source_set_callback (priv->stats_source,
+                             clutter_gst_video_sink_post_stats, sink, NULL);
+      g_source_attach (priv->stats_source, priv->clutter_main_context);
+    }
+
   return TRUE;
 }
 
@@ -1279,8 +4833,37 @@ clutter_gst_video_sink_stop (GstBaseSink *base_sink)
       priv->source = NULL;
     }
 
+  if (priv->repaint_func_id)
+    {
+      clutter_threads_remove_repaint_func (priv->repaint_func_id);
+      priv->repaint_func_id = 0;
+    }
+
+  if (priv->stats_source)
+    {
+      g_source_destroy (priv->stats_source);
+      g_source_unref (priv->stats_source);
+      priv->stats_source = NULL;
+    }
+
+  if (priv->pending_buffer)
+    {
+      gst_buffer_unref (priv->pending_buffer);
+      priv->pending_buffer = NULL;
+    }
+
+  clutter_gst_deinterlace_cancel_second_field (sink);
+  priv->prerolled_buffer = NULL;
+
+  /* priv->texture may already have been cleared by its weak pointer, the
+   * timeout has to go anyway */
+  clutter_gst_video_sink_cancel_downscale (sink);
+
   priv->renderer_state = CLUTTER_GST_RENDERER_STOPPED;
 
+  /* don't keep frames around while we are not streaming */
+  clutter_gst_buffer_pool_flush (priv->pool);
+
   return TRUE;
 }
 
@@ -1300,11 +4883,12 @@ clutter_gst_video_sink_class_init (ClutterGstVideoSinkClass *klass)
   gobject_class->finalize = clutter_gst_video_sink_finalize;
 
   gstbase_sink_class->render = clutter_gst_video_sink_render;
-  gstbase_sink_class->preroll = clutter_gst_video_sink_render;
+  gstbase_sink_class->preroll = clutter_gst_video_sink_preroll;
   gstbase_sink_class->start = clutter_gst_video_sink_start;
   gstbase_sink_class->stop = clutter_gst_video_sink_stop;
   gstbase_sink_class->set_caps = clutter_gst_video_sink_set_caps;
   gstbase_sink_class->get_caps = clutter_gst_video_sink_get_caps;
+  gstbase_sink_class->buffer_alloc = clutter_gst_video_sink_buffer_alloc;
 
   /**
    * ClutterGstVideoSink:texture:
@@ -1337,6 +4921,264 @@ clutter_gst_video_sink_class_init (ClutterGstVideoSinkClass *klass)
                             CLUTTER_GST_DEFAULT_PRIORITY,
                             CLUTTER_GST_PARAM_READWRITE);
   g_object_class_install_property (gobject_class, PROP_UPDATE_PRIORITY, pspec);
+
+  /**
+   * ClutterGstVideoSink:buffer-pool-size:
+   *
+   * The sink hands out buffers from a pool to the upstream elements so the
+   * memory of the frames can be reused once they have been uploaded. This
+   * property is the maximum number of unused frames the pool keeps around.
+   * 0 disables the pool.
+   *
+   * Since: 1.6
+   */
+  pspec = g_param_spec_uint ("buffer-pool-size",
+                             "Buffer pool size",
+                             "Maximum number of free frames kept for reuse",
+                             0, G_MAXUINT,
+                             CLUTTER_GST_DEFAULT_BUFFER_POOL_SIZE,
+                             CLUTTER_GST_PARAM_READWRITE);
+  g_object_class_install_property (gobject_class, PROP_BUFFER_POOL_SIZE,
+                                   pspec);
+
+  /**
+   * ClutterGstVideoSink:buffer-pool-stats:
+   *
+   * A #GstStructure with statistics about the buffer pool: "size" (the
+   * value of #ClutterGstVideoSink:buffer-pool-size), "free" and "allocated"
+   * number of frames, "block-size", "hits" and "misses" of the allocations,
+   * "allocated-bytes" and the "high-water-bytes" mark.
+   *
+   * Since: 1.6
+   */
+  pspec = g_param_spec_boxed ("buffer-pool-stats",
+                              "Buffer pool statistics",
+                              "Statistics about the buffer pool",
+                              GST_TYPE_STRUCTURE,
+                              CLUTTER_GST_PARAM_READABLE);
+  g_object_class_install_property (gobject_class, PROP_BUFFER_POOL_STATS,
+                                   pspec);
+
+  /**
+   * ClutterGstVideoSink:use-pixel-buffers:
+   *
+   * Whether to stream the frames to the GPU through pixel buffers. The
+   * streaming thread copies each frame into a pixel buffer while the Clutter
+   * thread paints the previous one, and the textures are then updated from
+   * GPU memory. If pixel buffers are not supported by the driver (or Cogl),
+   * the frames are uploaded directly.
+   *
+   * Since: 1.6
+   */
+  pspec = g_param_spec_boolean ("use-pixel-buffers",
+                                "Use pixel buffers",
+                                "Upload the frames through pixel buffers",
+                                FALSE,
+                                CLUTTER_GST_PARAM_READWRITE);
+  g_object_class_install_property (gobject_class, PROP_USE_PIXEL_BUFFERS,
+                                   pspec);
+
+  /**
+   * ClutterGstVideoSink:upload-on-paint:
+   *
+   * By default, frames are uploaded to the GPU as soon as they reach the
+   * Clutter thread. When this property is %TRUE, the sink only queues a
+   * redraw of the texture and uploads the latest frame right before the
+   * stage is painted, so at most one frame is uploaded per painted frame.
+   * Frames replaced by a newer one before the paint are dropped without
+   * being uploaded.
+   *
+   * Since: 1.6
+   */
+  pspec = g_param_spec_boolean ("upload-on-paint",
+                                "Upload on paint",
+                                "Only upload the frames right before painting",
+                                FALSE,
+                                CLUTTER_GST_PARAM_READWRITE);
+  g_object_class_install_property (gobject_class, PROP_UPLOAD_ON_PAINT,
+                                   pspec);
+
+  /**
+   * ClutterGstVideoSink:deinterlace-mode:
+   *
+   * How interlaced I420 and YV12 frames are deinterlaced. The work is done
+   * by the fragment shader, while painting the texture, instead of by a
+   * deinterlace element on the CPU. The mode is picked up when the caps
+   * are negotiated.
+   *
+   * Since: 1.6
+   */
+  pspec = g_param_spec_enum ("deinterlace-mode",
+                             "Deinterlace mode",
+                             "How to deinterlace interlaced frames",
+                             CLUTTER_GST_TYPE_DEINTERLACE_MODE,
+                             CLUTTER_GST_DEINTERLACE_MODE_NONE,
+                             CLUTTER_GST_PARAM_READWRITE);
+  g_object_class_install_property (gobject_class, PROP_DEINTERLACE_MODE,
+                                   pspec);
+
+  /**
+   * ClutterGstVideoSink:deinterlace-double-rate:
+   *
+   * When deinterlacing, show each field of the frames in turn, so the
+   * texture is updated at twice the frame rate, instead of only showing the
+   * first field of each frame. Has no effect with the linear blend.
+   *
+   * Since: 1.6
+   */
+  pspec = g_param_spec_boolean ("deinterlace-double-rate",
+                                "Deinterlace at double rate",
+                                "Show both fields of interlaced frames",
+                                FALSE,
+                                CLUTTER_GST_PARAM_READWRITE);
+  g_object_class_install_property (gobject_class,
+                                   PROP_DEINTERLACE_DOUBLE_RATE, pspec);
+
+  /**
+   * ClutterGstVideoSink:deinterlace-caps:
+   *
+   * The formats the sink is able to deinterlace with the GL context of
+   * Clutter, see #ClutterGstVideoSink:deinterlace-mode. Interlaced frames
+   * in other formats are shown as they are and have to be deinterlaced
+   * upstream.
+   *
+   * Since: 1.6
+   */
+  pspec = g_param_spec_boxed ("deinterlace-caps",
+                              "Deinterlace caps",
+                              "The formats the sink can deinterlace",
+                              GST_TYPE_CAPS,
+                              CLUTTER_GST_PARAM_READABLE);
+  g_object_class_install_property (gobject_class, PROP_DEINTERLACE_CAPS,
+                                   pspec);
+
+  /**
+   * ClutterGstVideoSink:downscale-threshold:
+   *
+   * When the frames are this many times bigger than the allocation of the
+   * texture, ask upstream for frames scaled down by a power of two, still
+   * at least as big as the texture, and ask for bigger frames again when
+   * the texture grows. Only decoders supporting low resolution decoding, or
+   * a videoscale element in front of the sink, can honour the request.
+   * 0 disables downscaling.
+   *
+   * Since: 1.6
+   */
+  pspec = g_param_spec_double ("downscale-threshold",
+                               "Downscale threshold",
+                               "Ratio between the size of the frames and "
+                               "the size of the texture above which smaller "
+                               "frames are asked for (0 = disabled)",
+                               0.0, G_MAXDOUBLE, 0.0,
+                               CLUTTER_GST_PARAM_READWRITE);
+  g_object_class_install_property (gobject_class, PROP_DOWNSCALE_THRESHOLD,
+                                   pspec);
+
+  /**
+   * ClutterGstVideoSink:stats:
+   *
+   * A #GstStructure with statistics about the frames, as returned by
+   * clutter_gst_video_sink_get_stats().
+   *
+   * Since: 1.6
+   */
+  pspec = g_param_spec_boxed ("stats",
+                              "Statistics",
+                              "Statistics about the frames",
+                              GST_TYPE_STRUCTURE,
+                              CLUTTER_GST_PARAM_READABLE);
+  g_object_class_install_property (gobject_class, PROP_STATS, pspec);
+
+  /**
+   * ClutterGstVideoSink:stats-interval:
+   *
+   * When not 0, the sink posts an element message with the structure
+   * returned by clutter_gst_video_sink_get_stats() on the bus every
+   * stats-interval milliseconds while it is started. The interval is picked
+   * up when the sink starts.
+   *
+   * Since: 1.6
+   */
+  pspec = g_param_spec_uint ("stats-interval",
+                             "Statistics interval",
+                             "Interval between the statistics messages "
+                             "posted on the bus, in ms (0 = none)",
+                             0, G_MAXUINT, 0,
+                             CLUTTER_GST_PARAM_READWRITE);
+  g_object_class_install_property (gobject_class, PROP_STATS_INTERVAL,
+                                   pspec);
+
+  /**
+   * ClutterGstVideoSink:trace-latency:
+   *
+   * Whether to record when each frame reaches the sink, is picked up by the
+   * Clutter thread, is uploaded and is first painted. The timings are
+   * emitted with #ClutterGstVideoSink::frame-latency, the last ones are kept
+   * for clutter_gst_video_sink_get_frame_timings() and, with the "latency"
+   * key of CLUTTER_GST_DEBUG, logged. Defaults to %TRUE when that debug key
+   * is set.
+   *
+   * Since: 1.6
+   */
+  pspec = g_param_spec_boolean ("trace-latency",
+                                "Trace latency",
+                                "Record the timing of the frames through "
+                                "the sink",
+                                FALSE,
+                                CLUTTER_GST_PARAM_READWRITE);
+  g_object_class_install_property (gobject_class, PROP_TRACE_LATENCY, pspec);
+
+  /**
+   * ClutterGstVideoSink:renderer:
+   *
+   * The name of the renderer to display the frames with, one of
+   * #ClutterGstVideoSink:renderers. Once set, the sink only accepts the
+   * formats that renderer handles. It has to be set before the sink
+   * negotiates its caps. When unset, the sink picks the renderer itself
+   * and reading the property gives the renderer in use, if any.
+   *
+   * Since: 1.6
+   */
+  pspec = g_param_spec_string ("renderer",
+                               "Renderer",
+                               "Name of the renderer to use",
+                               NULL,
+                               CLUTTER_GST_PARAM_READWRITE);
+  g_object_class_install_property (gobject_class, PROP_RENDERER, pspec);
+
+  /**
+   * ClutterGstVideoSink:renderers:
+   *
+   * The names of the renderers usable with the GL context of Clutter.
+   *
+   * Since: 1.6
+   */
+  pspec = g_param_spec_boxed ("renderers",
+                              "Renderers",
+                              "Names of the renderers usable with the GL "
+                              "context",
+                              G_TYPE_STRV,
+                              CLUTTER_GST_PARAM_READABLE);
+  g_object_class_install_property (gobject_class, PROP_RENDERERS, pspec);
+
+  /**
+   * ClutterGstVideoSink::frame-latency:
+   * @sink: the #ClutterGstVideoSink
+   * @timing: (type gpointer): the #ClutterGstFrameTiming of the frame
+   *
+   * Emitted from the Clutter thread when a frame is painted for the first
+   * time while #ClutterGstVideoSink:trace-latency is set. @timing is only
+   * valid during the emission.
+   *
+   * Since: 1.6
+   */
+  video_sink_signals[FRAME_LATENCY] =
+    g_signal_new ("frame-latency",
+                  G_TYPE_FROM_CLASS (klass),
+                  G_SIGNAL_RUN_LAST,
+                  0, NULL, NULL,
+                  g_cclosure_marshal_VOID__POINTER,
+                  G_TYPE_NONE, 1, G_TYPE_POINTER);
 }
 
 /**
@@ -1360,30 +5202,287 @@ clutter_gst_video_sink_new (ClutterTexture *texture)
                        NULL);
 }
 
+/**
+ * clutter_gst_video_sink_add_texture:
+ * @sink: a #ClutterGstVideoSink
+ * @texture: a #ClutterTexture
+ *
+ * Shows the video in @texture as well as in the #ClutterGstVideoSink:texture
+ * of @sink. The frames are only uploaded once, all the textures share the
+ * same #CoglMaterial, which makes this a lot cheaper than using a tee and
+ * one sink per texture. Navigation events are sent upstream from whichever
+ * texture receives them.
+ *
+ * The texture is removed from the sink when destroyed.
+ *
+ * <note>This function has to be called from Clutter's main thread.</note>
+ *
+ * Since: 1.6
+ */
+void
+clutter_gst_video_sink_add_texture (ClutterGstVideoSink *sink,
+                                    ClutterTexture      *texture)
+{
+  ClutterGstVideoSinkPrivate *priv;
+  CoglHandle material;
+
+  g_return_if_fail (CLUTTER_GST_IS_VIDEO_SINK (sink));
+  g_return_if_fail (CLUTTER_IS_TEXTURE (texture));
+
+  priv = sink->priv;
+
+  if (texture == priv->texture || g_slist_find (priv->textures, texture))
+    return;
+
+  priv->textures = g_slist_prepend (priv->textures, g_object_ref (texture));
+
+  clutter_gst_video_sink_connect_texture (sink, texture, NULL);
+  g_signal_connect (texture, "destroy",
+                    G_CALLBACK (on_extra_texture_destroy), sink);
+
+  /* show the current frame right away */
+  clutter_gst_video_sink_set_par (sink, texture);
+  if (priv->texture)
+    {
+      material = clutter_texture_get_cogl_material (priv->texture);
+      if (material != COGL_INVALID_HANDLE)
+        clutter_texture_set_cogl_material (texture, material);
+    }
+
+  clutter_gst_video_sink_update_visibility (sink);
+}
+
+/**
+ * clutter_gst_video_sink_remove_texture:
+ * @sink: a #ClutterGstVideoSink
+ * @texture: a #ClutterTexture added with
+ *   clutter_gst_video_sink_add_texture()
+ *
+ * Stops showing the video in @texture. The last frame stays in @texture.
+ *
+ * <note>This function has to be called from Clutter's main thread.</note>
+ *
+ * Since: 1.6
+ */
+void
+clutter_gst_video_sink_remove_texture (ClutterGstVideoSink *sink,
+                                       ClutterTexture      *texture)
+{
+  ClutterGstVideoSinkPrivate *priv;
+  GSList *link;
+
+  g_return_if_fail (CLUTTER_GST_IS_VIDEO_SINK (sink));
+  g_return_if_fail (CLUTTER_IS_TEXTURE (texture));
+
+  priv = sink->priv;
+
+  link = g_slist_find (priv->textures, texture);
+  if (link == NULL)
+    return;
+
+  priv->textures = g_slist_delete_link (priv->textures, link);
+  if (priv->input_actor == CLUTTER_ACTOR (texture))
+    priv->input_actor = NULL;
+
+  g_signal_handlers_disconnect_matched (texture, G_SIGNAL_MATCH_DATA,
+                                        0, 0, NULL, NULL, sink);
+  g_object_unref (texture);
+
+  clutter_gst_video_sink_update_visibility (sink);
+}
+
+/**
+ * clutter_gst_video_sink_get_stats:
+ * @sink: a #ClutterGstVideoSink
+ *
+ * Returns statistics about the frames since @sink last started, in a
+ * #GstStructure named "clutter-gst-video-sink-stats" with these fields:
+ * <itemizedlist>
+ *   <listitem>"received" (#guint): frames handed to the sink</listitem>
+ *   <listitem>"superseded" (#guint): frames replaced by a newer one before
+ *   the clutter thread picked them up</listitem>
+ *   <listitem>"dropped" (#guint): frames never uploaded, the superseded
+ *   ones included</listitem>
+ *   <listitem>"uploaded" (#guint): frames uploaded to the GPU</listitem>
+ *   <listitem>"painted" (#guint): uploaded frames painted at least
+ *   once</listitem>
+ *   <listitem>"bytes-uploaded" (#guint64) and "bytes-per-second"
+ *   (#gdouble), the rate over the last second or so</listitem>
+ *   <listitem>"upload-time-mean" and "upload-time-max" (#gdouble), in
+ *   seconds</listitem>
+ *   <listitem>"upload-time-histogram" (a #GST_TYPE_ARRAY of #guint): the
+ *   number of uploads that took less than 250us, then less than 500us,
+ *   1ms, 2ms, and so on up to 32ms, the last element counting the uploads
+ *   that took 32ms or more</listitem>
+ * </itemizedlist>
+ *
+ * This function can be called from any thread.
+ *
+ * Return value: (transfer full): a new #GstStructure, free with
+ *   gst_structure_free()
+ *
+ * Since: 1.6
+ */
+GstStructure *
+clutter_gst_video_sink_get_stats (ClutterGstVideoSink *sink)
+{
+  ClutterGstVideoSinkPrivate *priv;
+  GValue histogram = { 0, };
+  GValue bucket = { 0, };
+  GstStructure *stats;
+  gint uploaded;
+  guint i;
+
+  g_return_val_if_fail (CLUTTER_GST_IS_VIDEO_SINK (sink), NULL);
+
+  priv = sink->priv;
+  uploaded = g_atomic_int_get (&priv->frames_uploaded);
+
+  stats = gst_structure_new ("clutter-gst-video-sink-stats",
+                             "received", G_TYPE_UINT,
+                             g_atomic_int_get (&priv->frames_received),
+                             "superseded", G_TYPE_UINT,
+                             g_atomic_int_get (&priv->frames_superseded),
+                             "dropped", G_TYPE_UINT,
+                             g_atomic_int_get (&priv->dropped_frames),
+                             "uploaded", G_TYPE_UINT, uploaded,
+                             "painted", G_TYPE_UINT,
+                             g_atomic_int_get (&priv->frames_painted),
+                             NULL);
+
+  g_value_init (&histogram, GST_TYPE_ARRAY);
+  g_value_init (&bucket, G_TYPE_UINT);
+
+  g_mutex_lock (priv->stats_lock);
+
+  gst_structure_set (stats,
+                     "bytes-uploaded", G_TYPE_UINT64, priv->bytes_uploaded,
+                     "bytes-per-second", G_TYPE_DOUBLE, priv->bytes_per_second,
+                     "upload-time-mean", G_TYPE_DOUBLE,
+                     uploaded ? priv->upload_time_total / uploaded : 0.0,
+                     "upload-time-max", G_TYPE_DOUBLE, priv->upload_time_max,
+                     NULL);
+
+  for (i = 0; i < CLUTTER_GST_N_UPLOAD_BUCKETS; i++)
+    {
+      g_value_set_uint (&bucket, priv->upload_histogram[i]);
+      gst_value_array_append_value (&histogram, &bucket);
+    }
+
+  g_mutex_unlock (priv->stats_lock);
+
+  gst_structure_set_value (stats, "upload-time-histogram", &histogram);
+  g_value_unset (&histogram);
+  g_value_unset (&bucket);
+
+  return stats;
+}
+
+/**
+ * clutter_gst_video_sink_get_frame_timings:
+ * @sink: a #ClutterGstVideoSink
+ * @timings: (array length=n_timings) (out caller-allocates): where to
+ *   store the timings
+ * @n_timings: the number of elements of @timings
+ *
+ * Copies the timings of the last frames painted while
+ * #ClutterGstVideoSink:trace-latency was set, at most
+ * 256 of them, oldest first. This function can be called from any thread.
+ *
+ * Return value: the number of timings stored in @timings
+ *
+ * Since: 1.6
+ */
+guint
+clutter_gst_video_sink_get_frame_timings (ClutterGstVideoSink   *sink,
+                                          ClutterGstFrameTiming *timings,
+                                          guint                  n_timings)
+{
+  ClutterGstVideoSinkPrivate *priv;
+  guint i, first;
+
+  g_return_val_if_fail (CLUTTER_GST_IS_VIDEO_SINK (sink), 0);
+  g_return_val_if_fail (timings != NULL || n_timings == 0, 0);
+
+  priv = sink->priv;
+
+  g_mutex_lock (priv->stats_lock);
+
+  n_timings = MIN (n_timings, priv->n_timings);
+  first = priv->timing_ring_index + CLUTTER_GST_TIMING_RING_SIZE - n_timings;
+  for (i = 0; i < n_timings; i++)
+    timings[i] =
+      priv->timing_ring[(first + i) % CLUTTER_GST_TIMING_RING_SIZE];
+
+  g_mutex_unlock (priv->stats_lock);
+
+  return n_timings;
+}
+
+/**
+ * clutter_gst_video_sink_set_autotune:
+ * @autotune: whether to autotune the renderers
+ *
+ * Sets whether the video sinks measure, the first time they display a
+ * format, every renderer able to handle it on offscreen frames and use the
+ * fastest one. The outcome is cached on disk for the GL driver in use, so
+ * the measurement only happens once per format. This overrides the
+ * CLUTTER_GST_AUTOTUNE environment variable.
+ *
+ * This function has to be called from the clutter thread, after
+ * clutter_gst_init(), and applies to the formats displayed from then on.
+ *
+ * Since: 1.6
+ */
+void
+clutter_gst_video_sink_set_autotune (gboolean autotune)
+{
+  ClutterGstRendererRegistry *registry;
+
+  autotune = autotune != FALSE;
+
+  G_LOCK (renderer_registry);
+
+  clutter_gst_autotune = autotune;
+
+  registry = renderer_registry;
+  if (registry != NULL)
+    {
+      if (autotune && registry->tuning == NULL)
+        clutter_gst_renderer_registry_load_tuning (registry, TRUE);
+      g_atomic_int_set (&registry->autotune, autotune);
+    }
+
+  G_UNLOCK (renderer_registry);
+}
+
 static void
 clutter_gst_navigation_send_event (GstNavigation *navigation,
                                    GstStructure  *structure)
 {
   ClutterGstVideoSink *sink = CLUTTER_GST_VIDEO_SINK (navigation);
   ClutterGstVideoSinkPrivate *priv = sink->priv;
+  ClutterActor *actor;
   GstEvent *event;
   GstPad *pad = NULL;
   gdouble x, y;
   gfloat x_out, y_out;
 
+  actor = priv->input_actor ? priv->input_actor : CLUTTER_ACTOR (priv->texture);
+
   /* Converting pointer coordinates to the non scaled geometry
    * if the structure contains pointer coordinates */
   if (gst_structure_get_double (structure, "pointer_x", &x) &&
       gst_structure_get_double (structure, "pointer_y", &y))
     {
-      if (clutter_actor_transform_stage_point (CLUTTER_ACTOR (priv->texture), x, y, &x_out, &y_out) == FALSE)
+      if (clutter_actor_transform_stage_point (actor, x, y, &x_out, &y_out) == FALSE)
         {
           g_warning ("Failed to convert non-scaled coordinates for video-sink");
           return;
         }
 
-      x = x_out * priv->width / clutter_actor_get_width (CLUTTER_ACTOR (priv->texture));
-      y = y_out * priv->height / clutter_actor_get_height (CLUTTER_ACTOR (priv->texture));
+      x = x_out * priv->width / clutter_actor_get_width (actor);
+      y = y_out * priv->height / clutter_actor_get_height (actor);
 
       gst_structure_set (structure,
                          "pointer_x", G_TYPE_DOUBLE, (gdouble) x,
@@ -1404,12 +5503,18 @@ clutter_gst_navigation_send_event (GstNavigation *navigation,
 }
 
 static gboolean
-clutter_gst_navigation_supported (ClutterGstVideoSink *object, GType type)
+clutter_gst_interface_supported (GstImplementsInterface *iface,
+                                 GType                   type)
 {
-  g_assert (type == GST_TYPE_NAVIGATION);
+  g_assert (type == GST_TYPE_NAVIGATION || type == GST_TYPE_COLOR_BALANCE);
   return TRUE;
 }
 
+static void
+clutter_gst_implements_interface_init (GstImplementsInterfaceClass *klass)
+{
+  klass->supported = clutter_gst_interface_supported;
+}
 
 static void
 clutter_gst_navigation_interface_init (GstNavigationInterface *iface)
@@ -1417,6 +5522,113 @@ clutter_gst_navigation_interface_init (GstNavigationInterface *iface)
   iface->send_event = clutter_gst_navigation_send_event;
 }
 
+/*
+ * GstColorBalance implementation
+ *
+ * The balance is applied by the colour matrix of the YUV programs, it
+ * costs nothing to change and does not touch the frames on the CPU. It has
+ * no effect on RGB frames or with the ARB fragment program renderers.
+ */
+
+static const GList *
+clutter_gst_color_balance_list_channels (GstColorBalance *balance)
+{
+  ClutterGstVideoSink *sink = CLUTTER_GST_VIDEO_SINK (balance);
+
+  return sink->priv->balance_channels;
+}
+
+static gint
+clutter_gst_color_balance_channel_index (ClutterGstVideoSink    *sink,
+                                         GstColorBalanceChannel *channel)
+{
+  gint index;
+
+  index = g_list_index (sink->priv->balance_channels, channel);
+  if (index >= 0)
+    return index;
+
+  /* channels from another instance */
+  for (index = 0; index < CLUTTER_GST_N_BALANCE_CHANNELS; index++)
+    if (g_strcmp0 (channel->label,
+                   clutter_gst_balance_channel_names[index]) == 0)
+      return index;
+
+  return -1;
+}
+
+static gboolean
+clutter_gst_color_balance_redraw (gpointer data)
+{
+  ClutterGstVideoSink *sink = CLUTTER_GST_VIDEO_SINK (data);
+
+  g_atomic_int_set (&sink->priv->balance_redraw_queued, FALSE);
+  clutter_gst_video_sink_queue_redraw (sink);
+
+  return FALSE;
+}
+
+static void
+clutter_gst_color_balance_set_value (GstColorBalance        *balance,
+                                     GstColorBalanceChannel *channel,
+                                     gint                    value)
+{
+  ClutterGstVideoSink *sink = CLUTTER_GST_VIDEO_SINK (balance);
+  ClutterGstVideoSinkPrivate *priv = sink->priv;
+  gint index;
+
+  index = clutter_gst_color_balance_channel_index (sink, channel);
+  if (index < 0)
+    return;
+
+  value = CLAMP (value, CLUTTER_GST_BALANCE_MIN, CLUTTER_GST_BALANCE_MAX);
+  if (g_atomic_int_get (&priv->balance[index]) == value)
+    return;
+
+  g_atomic_int_set (&priv->balance[index], value);
+  g_atomic_int_set (&priv->yuv_matrix_dirty, TRUE);
+
+  /* called from the application thread, the textures can only be touched
+   * from the clutter one */
+  if (g_atomic_int_compare_and_exchange (&priv->balance_redraw_queued,
+                                         FALSE, TRUE))
+    {
+      GSource *source = g_idle_source_new ();
+
+      g_source_set_callback (source, clutter_gst_color_balance_redraw,
+                             gst_object_ref (sink),
+                             (GDestroyNotify) gst_object_unref);
+      g_source_attach (source, priv->clutter_main_context);
+      g_source_unref (source);
+    }
+
+  gst_color_balance_value_changed (balance, channel, value);
+}
+
+static gint
+clutter_gst_color_balance_get_value (GstColorBalance        *balance,
+                                     GstColorBalanceChannel *channel)
+{
+  ClutterGstVideoSink *sink = CLUTTER_GST_VIDEO_SINK (balance);
+  gint index;
+
+  index = clutter_gst_color_balance_channel_index (sink, channel);
+  if (index < 0)
+    return 0;
+
+  return g_atomic_int_get (&sink->priv->balance[index]);
+}
+
+static void
+clutter_gst_color_balance_interface_init (GstColorBalanceClass *klass)
+{
+  GST_COLOR_BALANCE_TYPE (klass) = GST_COLOR_BALANCE_HARDWARE;
+
+  klass->list_channels = clutter_gst_color_balance_list_channels;
+  klass->set_value = clutter_gst_color_balance_set_value;
+  klass->get_value = clutter_gst_color_balance_get_value;
+}
+
 static gboolean
 plugin_init (GstPlugin *plugin)
 {
@@ -64,6 +64,7 @@ G_BEGIN_DECLS
 typedef struct _ClutterGstVideoSink        ClutterGstVideoSink;
 typedef struct _ClutterGstVideoSinkClass   ClutterGstVideoSinkClass;
 typedef struct _ClutterGstVideoSinkPrivate ClutterGstVideoSinkPrivate;
+typedef struct _ClutterGstFrameTiming      ClutterGstFrameTiming;
 
 /**
  * ClutterGstVideoSink:
@@ -99,9 +100,47 @@ struct _ClutterGstVideoSinkClass
   void (* _clutter_reserved6) (void);
 };
 
+/**
+ * ClutterGstFrameTiming:
+ * @timestamp: the timestamp of the buffer
+ * @running_time: the running time of the buffer in the pipeline
+ * @render: when the buffer reached the sink
+ * @dispatch: when the Clutter thread picked the buffer up
+ * @upload: when the frame was done being uploaded
+ * @paint: when the frame was painted for the first time
+ *
+ * When a frame went through the stages of the sink, as recorded when
+ * #ClutterGstVideoSink:trace-latency is set. @render, @dispatch, @upload
+ * and @paint come from gst_util_get_timestamp(). The fields are
+ * %GST_CLOCK_TIME_NONE when unknown.
+ *
+ * Since: 1.6
+ */
+struct _ClutterGstFrameTiming
+{
+  GstClockTime timestamp;
+  GstClockTime running_time;
+  GstClockTime render;
+  GstClockTime dispatch;
+  GstClockTime upload;
+  GstClockTime paint;
+};
+
 GType       clutter_gst_video_sink_get_type    (void) G_GNUC_CONST;
 GstElement *clutter_gst_video_sink_new         (ClutterTexture *texture);
 
+void        clutter_gst_video_sink_add_texture    (ClutterGstVideoSink *sink,
+                                                   ClutterTexture      *texture);
+void        clutter_gst_video_sink_remove_texture (ClutterGstVideoSink *sink,
+                                                   ClutterTexture      *texture);
+
+GstStructure *clutter_gst_video_sink_get_stats    (ClutterGstVideoSink *sink);
+guint       clutter_gst_video_sink_get_frame_timings (ClutterGstVideoSink   *sink,
+                                                      ClutterGstFrameTiming *timings,
+                                                      guint                  n_timings);
+
+void        clutter_gst_video_sink_set_autotune   (gboolean autotune);
+
 G_END_DECLS
 
 #endif /* __CLUTTER_GST_VIDEO_SINK_H__ */
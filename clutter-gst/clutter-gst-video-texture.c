@@ -40,11 +40,14 @@
 #include "config.h"
 #endif
 
+#include <math.h>
 #include <string.h>
 
 #include <glib.h>
 #include <gio/gio.h>
+#include <gst/base/gstbasesink.h>
 #include <gst/video/video.h>
+#include <pango/pangocairo.h>
 
 #include "clutter-gst-debug.h"
 #include "clutter-gst-enum-types.h"
@@ -54,6 +57,17 @@
 #include "clutter-gst-video-sink.h"
 #include "clutter-gst-video-texture.h"
 
+/* number of refreshes a frame can stay on screen counted separately in the
+ * pacing report, the last bucket counts the frames staying longer */
+#define PACING_N_REPEATS 8
+
+/* frames further apart (in paint time or in timestamps) start a new run */
+#define PACING_MAX_GAP (GST_SECOND / 2)
+
+/* the effective frame rate is computed over the frames painted during the
+ * last second, at most that many of them */
+#define PACING_FPS_WINDOW 256
+
 struct _ClutterGstVideoTexturePrivate
 {
   /* width / height (in pixels) of the frame data before applying the pixel
@@ -70,15 +84,88 @@ struct _ClutterGstVideoTexturePrivate
 
   CoglHandle idle_material;
   CoglColor idle_color_unpre;
+
+  /* the current subtitle cue, drawn once in a texture and painted on top
+   * of the frames until the running time of the pipeline reaches
+   * subtitle_end. subtitle_width and subtitle_height are the size of that
+   * texture, in pixels of the frames */
+  GstElement *subtitle_sink;
+  CoglHandle subtitle_material;
+  gint subtitle_width;
+  gint subtitle_height;
+  GstClockTime subtitle_end;
+
+  /* frame pacing analysis, fed by the latency traces of the sink. The
+   * stage frames are counted from the first frame of the current run, runs
+   * being broken by seeks and pauses */
+  GstElement *video_sink;
+  gboolean pacing_analysis;
+  gdouble refresh_rate;
+  gulong frame_latency_id;
+  gboolean saved_trace_latency;   /* as set before the analysis */
+  guint repaint_func_id;
+  ClutterTimeline *redraw_timeline;
+  gint64 stage_frames;            /* repaints of the stages so far */
+  gint64 run_start_frame;         /* stage frame of the first frame */
+  GstClockTime last_timestamp;
+  GstClockTime last_paint;
+  gint64 last_refresh;
+  GstClockTime min_frame_duration;
+  GstClockTime report_start;
+  GstClockTime fps_window[PACING_FPS_WINDOW]; /* paint times */
+  guint fps_window_first;
+  guint fps_window_frames;
+  gdouble effective_fps;
+  guint frames;
+  guint stutters;
+  guint skips;
+  guint repeat_histogram[PACING_N_REPEATS];
 };
 
+/* a subtitle cue handed from the streaming thread of the text sink to the
+ * clutter thread. A NULL text clears the current cue */
+typedef struct
+{
+  ClutterGstVideoTexture *video_texture;
+  gchar *text;
+  gboolean is_markup;
+  GstClockTime end;               /* running time, NONE to show it until
+                                   * the next one */
+} SubtitleCue;
+
+/* around the glyphs, in pixels of the frames */
+#define SUBTITLE_OUTLINE_WIDTH 3
+/* between the cue and the bottom of the video, in fraction of its height */
+#define SUBTITLE_MARGIN 0.05
+
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+#define CAIRO_ARGB32_COGL_FORMAT COGL_PIXEL_FORMAT_BGRA_8888_PRE
+#else
+#define CAIRO_ARGB32_COGL_FORMAT COGL_PIXEL_FORMAT_ARGB_8888_PRE
+#endif
+
+/* the ids below PROP_IDLE_MATERIAL are the ones of the properties installed
+ * by clutter_gst_player_class_init() */
 enum {
   PROP_0,
 
-  PROP_IDLE_MATERIAL
+  PROP_IDLE_MATERIAL = 1024,
+  PROP_PACING_ANALYSIS,
+  PROP_REFRESH_RATE
 };
 
+enum {
+  PACING_REPORT,
+
+  LAST_SIGNAL
+};
+
+static guint video_texture_signals[LAST_SIGNAL] = { 0, };
+
 static void clutter_gst_video_texture_media_init (ClutterMediaIface *iface);
+static gboolean drop_subtitle (ClutterGstVideoTexture *video_texture);
+static gboolean subtitle_expired (ClutterGstVideoTexture *video_texture);
+static void paint_subtitle (ClutterGstVideoTexture *video_texture);
 static void clutter_gst_video_texture_player_init (ClutterGstPlayerIface *iface);
 
 G_DEFINE_TYPE_WITH_CODE (ClutterGstVideoTexture,
@@ -397,10 +484,660 @@ clutter_gst_video_texture_paint (ClutterActor *actor)
       actor_class =
         CLUTTER_ACTOR_CLASS (clutter_gst_video_texture_parent_class);
       actor_class->paint (actor);
+
+      if (subtitle_expired (video_texture))
+        drop_subtitle (video_texture);
+
+      if (priv->subtitle_material != COGL_INVALID_HANDLE)
+        paint_subtitle (video_texture);
     }
 
 }
 
+/*
+ * Subtitles
+ *
+ * Instead of letting playbin2 blend the subtitles into every frame with a
+ * textoverlay element, which means a read-modify-write of the whole frame
+ * on the CPU and no frame going straight to the sink, the text stream is
+ * routed to a fakesink. Each cue is drawn once, with Pango and cairo, in a
+ * small texture that is painted on top of the frames. Only text streams are
+ * taken over, the bitmap subtitles of DVDs and DVB are left to the overlay
+ * of playbin2.
+ */
+
+static gboolean
+drop_subtitle (ClutterGstVideoTexture *video_texture)
+{
+  ClutterGstVideoTexturePrivate *priv = video_texture->priv;
+
+  priv->subtitle_end = GST_CLOCK_TIME_NONE;
+
+  if (priv->subtitle_material == COGL_INVALID_HANDLE)
+    return FALSE;
+
+  cogl_handle_unref (priv->subtitle_material);
+  priv->subtitle_material = COGL_INVALID_HANDLE;
+
+  return TRUE;
+}
+
+static void
+clear_subtitle (ClutterGstVideoTexture *video_texture)
+{
+  if (drop_subtitle (video_texture))
+    clutter_actor_queue_redraw (CLUTTER_ACTOR (video_texture));
+}
+
+/* The cues expire on the running time of the pipeline, which stands still
+ * while paused or buffering, like the frames they are shown with. Checked
+ * at each paint, ie. at each new frame while playing */
+static gboolean
+subtitle_expired (ClutterGstVideoTexture *video_texture)
+{
+  ClutterGstVideoTexturePrivate *priv = video_texture->priv;
+  GstElement *pipeline;
+  GstClock *clock;
+  GstClockTime running_time;
+
+  if (!GST_CLOCK_TIME_IS_VALID (priv->subtitle_end))
+    return FALSE;
+
+  pipeline =
+    clutter_gst_player_get_pipeline (CLUTTER_GST_PLAYER (video_texture));
+  if (pipeline == NULL || GST_STATE (pipeline) != GST_STATE_PLAYING)
+    return FALSE;
+
+  clock = gst_element_get_clock (pipeline);
+  if (clock == NULL)
+    return FALSE;
+
+  running_time = gst_clock_get_time (clock) -
+                 gst_element_get_base_time (pipeline);
+  gst_object_unref (clock);
+
+  return running_time >= priv->subtitle_end;
+}
+
+/* Draws @layout with an outline, so that it can be read on top of any
+ * frame */
+static CoglHandle
+create_subtitle_texture (PangoLayout *layout,
+                         gint         width,
+                         gint         height)
+{
+  cairo_surface_t *surface;
+  CoglHandle texture;
+  cairo_t *cr;
+
+  surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, width, height);
+  cr = cairo_create (surface);
+
+  cairo_move_to (cr, SUBTITLE_OUTLINE_WIDTH, SUBTITLE_OUTLINE_WIDTH);
+  pango_cairo_layout_path (cr, layout);
+  cairo_set_source_rgb (cr, 0, 0, 0);
+  cairo_set_line_width (cr, SUBTITLE_OUTLINE_WIDTH * 2);
+  cairo_set_line_join (cr, CAIRO_LINE_JOIN_ROUND);
+  cairo_stroke_preserve (cr);
+  cairo_set_source_rgb (cr, 1, 1, 1);
+  cairo_fill (cr);
+
+  cairo_destroy (cr);
+  cairo_surface_flush (surface);
+
+  texture =
+    cogl_texture_new_from_data (width, height,
+                                COGL_TEXTURE_NO_SLICING,
+                                CAIRO_ARGB32_COGL_FORMAT,
+                                COGL_PIXEL_FORMAT_ANY,
+                                cairo_image_surface_get_stride (surface),
+                                cairo_image_surface_get_data (surface));
+  cairo_surface_destroy (surface);
+
+  return texture;
+}
+
+static void
+set_subtitle (ClutterGstVideoTexture *video_texture,
+              SubtitleCue            *cue)
+{
+  ClutterGstVideoTexturePrivate *priv = video_texture->priv;
+  PangoFontDescription *font_desc;
+  cairo_surface_t *surface;
+  PangoLayout *layout;
+  CoglHandle texture;
+  gchar *font_name = NULL;
+  gfloat frame_width;
+  gint width, height;
+  cairo_t *cr;
+
+  clear_subtitle (video_texture);
+
+  /* cues can still be on their way after dispose() */
+  if (priv->subtitle_sink == NULL)
+    return;
+
+  if (cue->text == NULL || cue->text[0] == '\0')
+    return;
+
+  clutter_gst_video_texture_get_natural_size (video_texture,
+                                              &frame_width, NULL);
+  if (frame_width <= 0)
+    return;
+
+  /* the layout only needs a cairo context for its font options */
+  surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, 1, 1);
+  cr = cairo_create (surface);
+  layout = pango_cairo_create_layout (cr);
+  cairo_destroy (cr);
+  cairo_surface_destroy (surface);
+
+  /* the font set with clutter_gst_player_set_subtitle_font_name() */
+  g_object_get (video_texture, "subtitle-font-name", &font_name, NULL);
+  font_desc = pango_font_description_from_string (font_name ? font_name
+                                                            : "Sans 16");
+  pango_layout_set_font_description (layout, font_desc);
+  pango_font_description_free (font_desc);
+  g_free (font_name);
+
+  pango_layout_set_alignment (layout, PANGO_ALIGN_CENTER);
+  pango_layout_set_wrap (layout, PANGO_WRAP_WORD_CHAR);
+  pango_layout_set_width (layout,
+                          (frame_width * 0.9 - 2 * SUBTITLE_OUTLINE_WIDTH) *
+                          PANGO_SCALE);
+
+  if (cue->is_markup)
+    pango_layout_set_markup (layout, cue->text, -1);
+  else
+    pango_layout_set_text (layout, cue->text, -1);
+
+  pango_layout_get_pixel_size (layout, &width, &height);
+  width += 2 * SUBTITLE_OUTLINE_WIDTH;
+  height += 2 * SUBTITLE_OUTLINE_WIDTH;
+
+  CLUTTER_GST_NOTE (SUBTITLES, "new cue (%dx%d, until %" GST_TIME_FORMAT
+                    "): %s", width, height, GST_TIME_ARGS (cue->end),
+                    cue->text);
+
+  texture = create_subtitle_texture (layout, width, height);
+  g_object_unref (layout);
+
+  priv->subtitle_material = cogl_material_new ();
+  cogl_material_set_layer (priv->subtitle_material, 0, texture);
+  cogl_handle_unref (texture);
+  priv->subtitle_width = width;
+  priv->subtitle_height = height;
+  priv->subtitle_end = cue->end;
+
+  clutter_actor_queue_redraw (CLUTTER_ACTOR (video_texture));
+}
+
+/* Paints the current cue at the bottom of the video, scaled with it */
+static void
+paint_subtitle (ClutterGstVideoTexture *video_texture)
+{
+  ClutterGstVideoTexturePrivate *priv = video_texture->priv;
+  ClutterActor *actor = CLUTTER_ACTOR (video_texture);
+  ClutterActorBox box;
+  gfloat frame_width, width, height, scale, x, y;
+  guint8 opacity;
+
+  clutter_gst_video_texture_get_natural_size (video_texture,
+                                              &frame_width, NULL);
+  if (frame_width <= 0)
+    return;
+
+  clutter_actor_get_allocation_box (actor, &box);
+  width = box.x2 - box.x1;
+  height = box.y2 - box.y1;
+  scale = width / frame_width;
+
+  x = (width - priv->subtitle_width * scale) / 2;
+  y = height * (1 - SUBTITLE_MARGIN) - priv->subtitle_height * scale;
+
+  opacity = clutter_actor_get_paint_opacity (actor);
+  cogl_material_set_color4ub (priv->subtitle_material,
+                              opacity, opacity, opacity, opacity);
+  cogl_set_source (priv->subtitle_material);
+  cogl_rectangle (x, y,
+                  x + priv->subtitle_width * scale,
+                  y + priv->subtitle_height * scale);
+}
+
+static gboolean
+set_subtitle_idle (gpointer data)
+{
+  SubtitleCue *cue = data;
+
+  set_subtitle (cue->video_texture, cue);
+
+  return FALSE;
+}
+
+static void
+subtitle_cue_free (gpointer data)
+{
+  SubtitleCue *cue = data;
+
+  g_object_unref (cue->video_texture);
+  g_free (cue->text);
+  g_slice_free (SubtitleCue, cue);
+}
+
+/* Called from the streaming thread of the text sink */
+static void
+queue_subtitle (ClutterGstVideoTexture *video_texture,
+                gchar                  *text,
+                gboolean                is_markup,
+                GstClockTime            end)
+{
+  SubtitleCue *cue;
+
+  cue = g_slice_new (SubtitleCue);
+  cue->video_texture = g_object_ref (video_texture);
+  cue->text = text;
+  cue->is_markup = is_markup;
+  cue->end = end;
+
+  g_idle_add_full (G_PRIORITY_DEFAULT,
+                   set_subtitle_idle,
+                   cue,
+                   subtitle_cue_free);
+}
+
+/* The text sink syncs on the clock, the buffers get there when the cue has
+ * to be shown */
+static void
+on_subtitle_handoff (GstElement             *text_sink,
+                     GstBuffer              *buffer,
+                     GstPad                 *pad,
+                     ClutterGstVideoTexture *video_texture)
+{
+  GstStructure *structure;
+  const gchar *media_type;
+  gboolean is_markup;
+  GstClockTime end = GST_CLOCK_TIME_NONE;
+
+  if (GST_BUFFER_CAPS (buffer) == NULL)
+    return;
+
+  structure = gst_caps_get_structure (GST_BUFFER_CAPS (buffer), 0);
+  media_type = gst_structure_get_name (structure);
+
+  if (strcmp (media_type, "text/x-pango-markup") == 0)
+    is_markup = TRUE;
+  else if (strcmp (media_type, "text/plain") == 0)
+    is_markup = FALSE;
+  else
+    return;
+
+  /* when the cue stops being shown, in running time */
+  if (GST_BUFFER_TIMESTAMP_IS_VALID (buffer) &&
+      GST_BUFFER_DURATION_IS_VALID (buffer))
+    {
+      GST_OBJECT_LOCK (text_sink);
+      end = gst_segment_to_running_time (&GST_BASE_SINK (text_sink)->segment,
+                                         GST_FORMAT_TIME,
+                                         GST_BUFFER_TIMESTAMP (buffer) +
+                                         GST_BUFFER_DURATION (buffer));
+      GST_OBJECT_UNLOCK (text_sink);
+    }
+
+  queue_subtitle (video_texture,
+                  g_strndup ((const gchar *) GST_BUFFER_DATA (buffer),
+                             GST_BUFFER_SIZE (buffer)),
+                  is_markup,
+                  end);
+}
+
+/* don't leave the cue shown before a seek on screen */
+static gboolean
+on_subtitle_event (GstPad                 *pad,
+                   GstEvent               *event,
+                   ClutterGstVideoTexture *video_texture)
+{
+  if (GST_EVENT_TYPE (event) == GST_EVENT_FLUSH_STOP)
+    queue_subtitle (video_texture, NULL, FALSE, GST_CLOCK_TIME_NONE);
+
+  return TRUE;
+}
+
+static GstElement *
+create_subtitle_sink (ClutterGstVideoTexture *video_texture)
+{
+  GstElement *text_sink;
+  GstPad *pad;
+
+  text_sink = gst_element_factory_make ("fakesink", "subtitle-sink");
+  if (text_sink == NULL)
+    return NULL;
+
+  /* the text stream is sparse, not waiting for a buffer to preroll keeps
+   * it from holding up the state changes of the pipeline */
+  g_object_set (text_sink,
+                "sync", TRUE,
+                "async", FALSE,
+                "signal-handoffs", TRUE,
+                NULL);
+  g_signal_connect (text_sink, "handoff",
+                    G_CALLBACK (on_subtitle_handoff), video_texture);
+
+  pad = gst_element_get_static_pad (text_sink, "sink");
+  gst_pad_add_event_probe (pad, G_CALLBACK (on_subtitle_event), video_texture);
+  gst_object_unref (pad);
+
+  return text_sink;
+}
+
+static gboolean
+is_text_stream (GstElement *pipeline,
+                gint        stream)
+{
+  GstPad *pad = NULL, *peer;
+  GstCaps *caps = NULL;
+  const gchar *media_type;
+  gboolean ret = FALSE;
+
+  /* the pad of the stream selector, its peer has the caps of the stream */
+  g_signal_emit_by_name (pipeline, "get-text-pad", stream, &pad);
+  if (pad == NULL)
+    return FALSE;
+
+  peer = gst_pad_get_peer (pad);
+  if (peer)
+    {
+      caps = gst_pad_get_negotiated_caps (peer);
+      if (caps == NULL)
+        caps = gst_pad_get_caps (peer);
+      gst_object_unref (peer);
+    }
+  gst_object_unref (pad);
+
+  if (caps && gst_caps_get_size (caps) > 0)
+    {
+      media_type = gst_structure_get_name (gst_caps_get_structure (caps, 0));
+      ret = strcmp (media_type, "text/plain") == 0 ||
+            strcmp (media_type, "text/x-pango-markup") == 0;
+    }
+
+  if (caps)
+    gst_caps_unref (caps);
+
+  return ret;
+}
+
+/* Called from the streaming thread when the subtitle streams change, before
+ * playbin2 sets up its text chain. Our sink is only used when all the
+ * streams are text, otherwise playbin2 plugs its own overlay */
+static void
+on_text_changed (GstElement             *pipeline,
+                 ClutterGstVideoTexture *video_texture)
+{
+  ClutterGstVideoTexturePrivate *priv = video_texture->priv;
+  GstElement *text_sink = NULL;
+  gint n_text = 0, i;
+  gboolean all_text = TRUE;
+
+  if (priv->subtitle_sink == NULL)
+    return;
+
+  g_object_get (pipeline, "n-text", &n_text, NULL);
+  for (i = 0; all_text && i < n_text; i++)
+    all_text = is_text_stream (pipeline, i);
+
+  g_object_get (pipeline, "text-sink", &text_sink, NULL);
+
+  if (all_text && text_sink != priv->subtitle_sink)
+    {
+      CLUTTER_GST_NOTE (SUBTITLES, "drawing the subtitles ourselves");
+      g_object_set (pipeline, "text-sink", priv->subtitle_sink, NULL);
+    }
+  else if (!all_text && text_sink == priv->subtitle_sink)
+    {
+      CLUTTER_GST_NOTE (SUBTITLES, "bitmap subtitles, using the overlay of "
+                        "playbin2");
+      g_object_set (pipeline, "text-sink", NULL, NULL);
+    }
+
+  if (text_sink)
+    gst_object_unref (text_sink);
+}
+
+/*
+ * Frame pacing
+ *
+ * With the latency tracing of the sink, we know when each frame is first
+ * painted. Counted in frames of the stage, the time between two frames is
+ * how many refreshes the first one stayed on screen. Frames 1/24s apart on
+ * a 60Hz stage should alternate between 2 and 3 refreshes, anything else
+ * is judder. The stage frames are counted by a repaint function, and a
+ * timeline keeps the stage redrawing at every refresh while playing.
+ */
+
+static void
+reset_pacing_run (ClutterGstVideoTexture *video_texture)
+{
+  ClutterGstVideoTexturePrivate *priv = video_texture->priv;
+
+  priv->run_start_frame = priv->stage_frames;
+  priv->last_timestamp = GST_CLOCK_TIME_NONE;
+  priv->last_paint = GST_CLOCK_TIME_NONE;
+  priv->last_refresh = 0;
+}
+
+static void
+reset_pacing (ClutterGstVideoTexture *video_texture)
+{
+  ClutterGstVideoTexturePrivate *priv = video_texture->priv;
+
+  reset_pacing_run (video_texture);
+
+  priv->min_frame_duration = GST_CLOCK_TIME_NONE;
+  priv->report_start = GST_CLOCK_TIME_NONE;
+  priv->fps_window_first = 0;
+  priv->fps_window_frames = 0;
+  priv->effective_fps = 0;
+  priv->frames = priv->stutters = priv->skips = 0;
+  memset (priv->repeat_histogram, 0, sizeof (priv->repeat_histogram));
+}
+
+/* Accounts for the frame shown before the one with @timestamp, which
+ * showed up at the @refresh'th stage frame of the run */
+static void
+account_repeats (ClutterGstVideoTexture *video_texture,
+                 GstClockTime            timestamp,
+                 gint64                  refresh)
+{
+  ClutterGstVideoTexturePrivate *priv = video_texture->priv;
+  GstClockTime duration;
+  gdouble expected;
+  gint64 repeats;
+
+  duration = timestamp - priv->last_timestamp;
+  repeats = refresh - priv->last_refresh;
+
+  priv->repeat_histogram[MIN (repeats, PACING_N_REPEATS - 1)]++;
+
+  /* the frame should have stayed on screen for its duration, give or take
+   * the rounding to a whole number of refreshes */
+  expected = priv->refresh_rate * duration / GST_SECOND;
+  if (repeats < floor (expected) || repeats > ceil (expected))
+    {
+      priv->stutters++;
+      CLUTTER_GST_NOTE (LATENCY, "stutter: frame %" GST_TIME_FORMAT " shown "
+                        "for %" G_GINT64_FORMAT " refreshes instead of %.2f",
+                        GST_TIME_ARGS (priv->last_timestamp), repeats,
+                        expected);
+    }
+
+  /* frames missing upstream or dropped on the way */
+  if (GST_CLOCK_TIME_IS_VALID (priv->min_frame_duration) &&
+      duration > priv->min_frame_duration * 3 / 2)
+    priv->skips++;
+
+  if (!GST_CLOCK_TIME_IS_VALID (priv->min_frame_duration) ||
+      duration < priv->min_frame_duration)
+    priv->min_frame_duration = duration;
+}
+
+/* Updates the frame rate over the frames painted during the last second
+ * with the one painted at @paint */
+static void
+account_fps (ClutterGstVideoTexture *video_texture,
+             GstClockTime            paint)
+{
+  ClutterGstVideoTexturePrivate *priv = video_texture->priv;
+  GstClockTime first;
+
+  if (priv->fps_window_frames == PACING_FPS_WINDOW)
+    {
+      priv->fps_window_first =
+        (priv->fps_window_first + 1) % PACING_FPS_WINDOW;
+      priv->fps_window_frames--;
+    }
+  priv->fps_window[(priv->fps_window_first + priv->fps_window_frames) %
+                   PACING_FPS_WINDOW] = paint;
+  priv->fps_window_frames++;
+
+  while (paint - priv->fps_window[priv->fps_window_first] > GST_SECOND)
+    {
+      priv->fps_window_first =
+        (priv->fps_window_first + 1) % PACING_FPS_WINDOW;
+      priv->fps_window_frames--;
+    }
+
+  first = priv->fps_window[priv->fps_window_first];
+  if (priv->fps_window_frames > 1 && paint > first)
+    priv->effective_fps = (gdouble) (priv->fps_window_frames - 1) *
+                          GST_SECOND / (paint - first);
+}
+
+static gboolean
+count_stage_frame (gpointer data)
+{
+  ClutterGstVideoTexture *video_texture = data;
+
+  video_texture->priv->stage_frames++;
+
+  return TRUE;
+}
+
+/* With the sync to the vertical blanking, redrawing at every frame of the
+ * master clock makes the stage frames the refreshes of the display */
+static void
+on_redraw_timeline_new_frame (ClutterTimeline        *timeline,
+                              gint                    msecs,
+                              ClutterGstVideoTexture *video_texture)
+{
+  if (clutter_media_get_playing (CLUTTER_MEDIA (video_texture)))
+    clutter_actor_queue_redraw (CLUTTER_ACTOR (video_texture));
+}
+
+static void
+on_frame_latency (ClutterGstVideoSink     *sink,
+                  ClutterGstFrameTiming   *timing,
+                  ClutterGstVideoTexture  *video_texture)
+{
+  ClutterGstVideoTexturePrivate *priv = video_texture->priv;
+  GstStructure *report;
+  gint64 refresh;
+
+  if (!GST_CLOCK_TIME_IS_VALID (timing->timestamp) ||
+      !GST_CLOCK_TIME_IS_VALID (timing->paint))
+    return;
+
+  /* seeks, pauses and discontinuities start a new run */
+  if (!GST_CLOCK_TIME_IS_VALID (priv->last_timestamp) ||
+      timing->timestamp <= priv->last_timestamp ||
+      timing->timestamp - priv->last_timestamp > PACING_MAX_GAP ||
+      timing->paint - priv->last_paint > PACING_MAX_GAP)
+    {
+      reset_pacing_run (video_texture);
+    }
+
+  /* the frame of the stage the frame showed up at, the sink traces the
+   * paint of the frames while the stages are being painted */
+  refresh = priv->stage_frames - priv->run_start_frame;
+
+  if (GST_CLOCK_TIME_IS_VALID (priv->last_timestamp))
+    account_repeats (video_texture, timing->timestamp, refresh);
+
+  priv->frames++;
+  priv->last_timestamp = timing->timestamp;
+  priv->last_paint = timing->paint;
+  priv->last_refresh = refresh;
+
+  account_fps (video_texture, timing->paint);
+
+  if (!GST_CLOCK_TIME_IS_VALID (priv->report_start))
+    priv->report_start = timing->paint;
+
+  if (timing->paint - priv->report_start >= GST_SECOND)
+    {
+      priv->report_start = timing->paint;
+
+      report = clutter_gst_video_texture_get_pacing_report (video_texture);
+      g_signal_emit (video_texture, video_texture_signals[PACING_REPORT], 0,
+                     report);
+      gst_structure_free (report);
+    }
+}
+
+static void
+set_pacing_analysis (ClutterGstVideoTexture *video_texture,
+                     gboolean                enable)
+{
+  ClutterGstVideoTexturePrivate *priv = video_texture->priv;
+
+  if (priv->pacing_analysis == enable)
+    return;
+
+  priv->pacing_analysis = enable;
+
+  if (priv->video_sink == NULL)
+    return;
+
+  if (enable)
+    {
+      reset_pacing (video_texture);
+      g_object_get (priv->video_sink,
+                    "trace-latency", &priv->saved_trace_latency,
+                    NULL);
+      g_object_set (priv->video_sink, "trace-latency", TRUE, NULL);
+      priv->frame_latency_id =
+        g_signal_connect (priv->video_sink, "frame-latency",
+                          G_CALLBACK (on_frame_latency), video_texture);
+
+      priv->repaint_func_id =
+        clutter_threads_add_repaint_func (count_stage_frame, video_texture,
+                                          NULL);
+
+      priv->redraw_timeline = clutter_timeline_new (1000);
+      clutter_timeline_set_loop (priv->redraw_timeline, TRUE);
+      g_signal_connect (priv->redraw_timeline, "new-frame",
+                        G_CALLBACK (on_redraw_timeline_new_frame),
+                        video_texture);
+      clutter_timeline_start (priv->redraw_timeline);
+    }
+  else
+    {
+      g_signal_handler_disconnect (priv->video_sink, priv->frame_latency_id);
+      priv->frame_latency_id = 0;
+
+      clutter_threads_remove_repaint_func (priv->repaint_func_id);
+      priv->repaint_func_id = 0;
+
+      clutter_timeline_stop (priv->redraw_timeline);
+      g_object_unref (priv->redraw_timeline);
+      priv->redraw_timeline = NULL;
+
+      /* the application may trace the latency itself */
+      g_object_set (priv->video_sink,
+                    "trace-latency", priv->saved_trace_latency,
+                    NULL);
+    }
+}
+
 /*
  * GObject implementation
  */
@@ -409,9 +1146,26 @@ static void
 clutter_gst_video_texture_dispose (GObject *object)
 {
   ClutterGstVideoTexture *self = CLUTTER_GST_VIDEO_TEXTURE (object);
+  GstElement *pipeline;
+
+  pipeline = clutter_gst_player_get_pipeline (CLUTTER_GST_PLAYER (self));
+  if (pipeline)
+    g_signal_handlers_disconnect_by_func (pipeline, on_text_changed, self);
+
+  set_pacing_analysis (self, FALSE);
 
   clutter_gst_player_deinit (CLUTTER_GST_PLAYER (self));
 
+  /* owned by the pipeline */
+  self->priv->video_sink = NULL;
+
+  if (self->priv->subtitle_sink)
+    {
+      gst_object_unref (self->priv->subtitle_sink);
+      self->priv->subtitle_sink = NULL;
+    }
+  clear_subtitle (self);
+
   G_OBJECT_CLASS (clutter_gst_video_texture_parent_class)->dispose (object);
 }
 
@@ -445,6 +1199,14 @@ clutter_gst_video_texture_set_property (GObject      *object,
                                                    g_value_get_boxed (value));
       break;
 
+    case PROP_PACING_ANALYSIS:
+      set_pacing_analysis (video_texture, g_value_get_boolean (value));
+      break;
+
+    case PROP_REFRESH_RATE:
+      video_texture->priv->refresh_rate = g_value_get_double (value);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
     }
@@ -468,6 +1230,14 @@ clutter_gst_video_texture_get_property (GObject    *object,
       g_value_set_boxed (value, priv->idle_material);
       break;
 
+    case PROP_PACING_ANALYSIS:
+      g_value_set_boolean (value, priv->pacing_analysis);
+      break;
+
+    case PROP_REFRESH_RATE:
+      g_value_set_double (value, priv->refresh_rate);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
     }
@@ -503,6 +1273,64 @@ clutter_gst_video_texture_class_init (ClutterGstVideoTextureClass *klass)
                               CLUTTER_GST_PARAM_READWRITE);
   g_object_class_install_property (object_class, PROP_IDLE_MATERIAL, pspec);
 
+  /**
+   * ClutterGstVideoTexture:pacing-analysis:
+   *
+   * Whether to check that the frames stay on screen for the number of
+   * refreshes of the stage their duration asks for. The results are
+   * reported every second with the #ClutterGstVideoTexture::pacing-report
+   * signal.
+   *
+   * The refreshes are counted in frames of the stage, so while the
+   * analysis is enabled the stage is redrawn at every frame during the
+   * playback.
+   *
+   * Since: 1.6
+   */
+  pspec = g_param_spec_boolean ("pacing-analysis",
+                                "Pacing analysis",
+                                "Whether to analyze the pacing of the frames",
+                                FALSE,
+                                CLUTTER_GST_PARAM_READWRITE);
+  g_object_class_install_property (object_class, PROP_PACING_ANALYSIS, pspec);
+
+  /**
+   * ClutterGstVideoTexture:refresh-rate:
+   *
+   * The refresh rate of the display the stage is shown on, in Hz. The
+   * pacing analysis compares the number of stage frames each frame stayed
+   * on screen with the number of refreshes its duration covers at that
+   * rate.
+   *
+   * Since: 1.6
+   */
+  pspec = g_param_spec_double ("refresh-rate",
+                               "Refresh rate",
+                               "Refresh rate of the display in Hz",
+                               1.0, G_MAXDOUBLE, 60.0,
+                               CLUTTER_GST_PARAM_READWRITE);
+  g_object_class_install_property (object_class, PROP_REFRESH_RATE, pspec);
+
+  /**
+   * ClutterGstVideoTexture::pacing-report:
+   * @texture: the #ClutterGstVideoTexture that received the signal
+   * @report: a #GstStructure, see
+   *   clutter_gst_video_texture_get_pacing_report()
+   *
+   * Emitted every second of playback when
+   * #ClutterGstVideoTexture:pacing-analysis is enabled.
+   *
+   * Since: 1.6
+   */
+  video_texture_signals[PACING_REPORT] =
+    g_signal_new ("pacing-report",
+                  CLUTTER_GST_TYPE_VIDEO_TEXTURE,
+                  G_SIGNAL_RUN_LAST,
+                  0,
+                  NULL, NULL,
+                  g_cclosure_marshal_VOID__BOXED,
+                  G_TYPE_NONE, 1, GST_TYPE_STRUCTURE);
+
   clutter_gst_player_class_init (object_class);
 }
 
@@ -512,13 +1340,16 @@ idle_cb (ClutterGstVideoTexture *video_texture,
          gpointer                data)
 {
   /* restore the idle material so we don't just display the last frame */
+  if (clutter_gst_player_get_idle (CLUTTER_GST_PLAYER (video_texture)))
+    clear_subtitle (video_texture);
+
   clutter_actor_queue_redraw (CLUTTER_ACTOR (video_texture));
 }
 
 static gboolean
 setup_pipeline (ClutterGstVideoTexture *video_texture)
 {
-  GstElement *pipeline, *video_sink;
+  GstElement *pipeline, *video_sink, *text_sink;
 
   pipeline =
     clutter_gst_player_get_pipeline (CLUTTER_GST_PLAYER (video_texture));
@@ -535,6 +1366,21 @@ setup_pipeline (ClutterGstVideoTexture *video_texture)
                 "subtitle-font-desc", "Sans 16",
                 NULL);
 
+  /* with a text sink, playbin2 does not plug a textoverlay element. The
+   * sink is kept alive by the text-sink property of playbin2 or by us while
+   * playbin2 uses its overlay */
+  text_sink = create_subtitle_sink (video_texture);
+  if (text_sink)
+    {
+      video_texture->priv->subtitle_sink = gst_object_ref (text_sink);
+      gst_object_sink (text_sink);
+      g_object_set (G_OBJECT (pipeline), "text-sink", text_sink, NULL);
+      g_signal_connect (pipeline, "text-changed",
+                        G_CALLBACK (on_text_changed), video_texture);
+    }
+
+  video_texture->priv->video_sink = video_sink;
+
   return TRUE;
 }
 
@@ -548,6 +1394,10 @@ clutter_gst_video_texture_init (ClutterGstVideoTexture *video_texture)
                                  CLUTTER_GST_TYPE_VIDEO_TEXTURE,
                                  ClutterGstVideoTexturePrivate);
 
+  priv->subtitle_end = GST_CLOCK_TIME_NONE;
+  priv->refresh_rate = 60.0;
+  reset_pacing (video_texture);
+
   if (!clutter_gst_player_init (CLUTTER_GST_PLAYER (video_texture)))
     {
       g_warning ("Failed to initiate suitable playback pipeline.");
@@ -887,3 +1737,69 @@ clutter_gst_video_texture_set_subtitle_track (ClutterGstVideoTexture *texture,
 {
   clutter_gst_player_set_subtitle_track (CLUTTER_GST_PLAYER (texture), index_);
 }
+
+/**
+ * clutter_gst_video_texture_get_pacing_report:
+ * @texture: a #ClutterGstVideoTexture
+ *
+ * Gets the results of the frame pacing analysis so far, see
+ * #ClutterGstVideoTexture:pacing-analysis. The "clutter-gst-pacing-report"
+ * structure has the following fields:
+ *
+ * <itemizedlist>
+ *   <listitem><para>"frames" (guint): the frames analyzed</para></listitem>
+ *   <listitem><para>"stutters" (guint): the frames that did not stay on
+ *   screen for the number of refreshes their duration asks
+ *   for</para></listitem>
+ *   <listitem><para>"skips" (guint): the gaps in the timestamps of the
+ *   frames, frames dropped on the way or missing upstream</para></listitem>
+ *   <listitem><para>"refresh-rate" (gdouble): the refresh rate the analysis
+ *   used, in Hz</para></listitem>
+ *   <listitem><para>"effective-fps" (gdouble): the frame rate over the
+ *   frames shown during the last second, updated at every
+ *   frame</para></listitem>
+ *   <listitem><para>"repeat-histogram" (#GST_TYPE_ARRAY of guint): how many
+ *   frames stayed on screen for 0, 1, 2... refreshes, the last bucket
+ *   counting the frames that stayed longer</para></listitem>
+ * </itemizedlist>
+ *
+ * Return value: (transfer full): a newly allocated #GstStructure, free it
+ *   with gst_structure_free()
+ *
+ * Since: 1.6
+ */
+GstStructure *
+clutter_gst_video_texture_get_pacing_report (ClutterGstVideoTexture *texture)
+{
+  ClutterGstVideoTexturePrivate *priv;
+  GstStructure *report;
+  GValue histogram = { 0, };
+  GValue bucket = { 0, };
+  gint i;
+
+  g_return_val_if_fail (CLUTTER_GST_IS_VIDEO_TEXTURE (texture), NULL);
+
+  priv = texture->priv;
+
+  g_value_init (&histogram, GST_TYPE_ARRAY);
+  g_value_init (&bucket, G_TYPE_UINT);
+  for (i = 0; i < PACING_N_REPEATS; i++)
+    {
+      g_value_set_uint (&bucket, priv->repeat_histogram[i]);
+      gst_value_array_append_value (&histogram, &bucket);
+    }
+  g_value_unset (&bucket);
+
+  report = gst_structure_new ("clutter-gst-pacing-report",
+                              "frames", G_TYPE_UINT, priv->frames,
+                              "stutters", G_TYPE_UINT, priv->stutters,
+                              "skips", G_TYPE_UINT, priv->skips,
+                              "refresh-rate", G_TYPE_DOUBLE, priv->refresh_rate,
+                              "effective-fps", G_TYPE_DOUBLE,
+                              priv->effective_fps,
+                              NULL);
+  gst_structure_set_value (report, "repeat-histogram", &histogram);
+  g_value_unset (&histogram);
+
+  return report;
+}
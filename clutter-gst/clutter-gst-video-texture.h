@@ -126,6 +126,7 @@ GList *                   clutter_gst_video_texture_get_subtitle_tracks (Clutter
 gint                      clutter_gst_video_texture_get_subtitle_track  (ClutterGstVideoTexture *texture);
 void                      clutter_gst_video_texture_set_subtitle_track  (ClutterGstVideoTexture *texture,
                                                                          gint                    index_);
+GstStructure *            clutter_gst_video_texture_get_pacing_report   (ClutterGstVideoTexture *texture);
 
 G_END_DECLS
 
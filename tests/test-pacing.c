@@ -0,0 +1,169 @@
+/*
+ * Clutter-GStreamer.
+ *
+ * GStreamer integration library for Clutter.
+ *
+ * test-pacing.c - Play a video with the frame pacing analysis of the
+ * video texture enabled, print its reports and fail when too many frames
+ * stuttered.
+ *
+ * Copyright (C) 2011 Intel Corporation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <stdlib.h>
+
+#include <clutter-gst/clutter-gst.h>
+
+static gint     opt_duration     = 10;
+static gdouble  opt_refresh_rate = 60.0;
+static gdouble  opt_max_stutters = 0.05;
+
+static GOptionEntry options[] =
+{
+  { "duration",
+    'd', 0,
+    G_OPTION_ARG_INT,
+    &opt_duration,
+    "Seconds of video to analyze (default is 10)",
+    NULL
+  },
+  { "refresh-rate",
+    'r', 0,
+    G_OPTION_ARG_DOUBLE,
+    &opt_refresh_rate,
+    "Refresh rate of the display in Hz (default is 60)",
+    NULL
+  },
+  { "max-stutter-ratio",
+    's', 0,
+    G_OPTION_ARG_DOUBLE,
+    &opt_max_stutters,
+    "Fraction of the frames allowed to stutter (default is 0.05)",
+    NULL
+  },
+
+  { NULL }
+};
+
+static void
+on_pacing_report (ClutterGstVideoTexture *texture,
+                  GstStructure           *report,
+                  gpointer                user_data)
+{
+  gchar *str;
+
+  str = gst_structure_to_string (report);
+  g_print ("%s\n", str);
+  g_free (str);
+}
+
+static void
+on_eos (ClutterMedia *media,
+        gpointer      user_data)
+{
+  clutter_main_quit ();
+}
+
+static void
+on_error (ClutterMedia *media,
+          GError       *error,
+          gpointer      user_data)
+{
+  g_printerr ("%s\n", error->message);
+  clutter_main_quit ();
+}
+
+static gboolean
+on_timeout (gpointer user_data)
+{
+  clutter_main_quit ();
+
+  return FALSE;
+}
+
+int
+main (int argc, char *argv[])
+{
+  GError *error = NULL;
+  ClutterActor *stage, *texture;
+  GstStructure *report;
+  guint frames, stutters;
+  gboolean passed;
+
+  if (!g_thread_supported ())
+    g_thread_init (NULL);
+
+  clutter_gst_init_with_args (&argc,
+                              &argv,
+                              " <uri> - Analyze the pacing of the frames",
+                              options,
+                              NULL,
+                              &error);
+
+  if (error)
+    {
+      g_print ("%s\n", error->message);
+      g_error_free (error);
+      return EXIT_FAILURE;
+    }
+
+  if (argc < 2)
+    {
+      g_print ("Usage: %s [OPTIONS] <uri>\n", argv[0]);
+      return EXIT_FAILURE;
+    }
+
+  stage = clutter_stage_get_default ();
+  clutter_actor_set_size (stage, 640, 480);
+
+  texture = g_object_new (CLUTTER_GST_TYPE_VIDEO_TEXTURE,
+                          "disable-slicing", TRUE,
+                          "refresh-rate", opt_refresh_rate,
+                          "pacing-analysis", TRUE,
+                          NULL);
+  clutter_actor_set_size (texture, 640, 480);
+  clutter_container_add_actor (CLUTTER_CONTAINER (stage), texture);
+
+  g_signal_connect (texture, "pacing-report",
+                    G_CALLBACK (on_pacing_report), NULL);
+  g_signal_connect (texture, "eos", G_CALLBACK (on_eos), NULL);
+  g_signal_connect (texture, "error", G_CALLBACK (on_error), NULL);
+
+  clutter_media_set_uri (CLUTTER_MEDIA (texture), argv[1]);
+  clutter_media_set_playing (CLUTTER_MEDIA (texture), TRUE);
+
+  g_timeout_add_seconds (opt_duration, on_timeout, NULL);
+
+  clutter_actor_show_all (stage);
+  clutter_main ();
+
+  clutter_media_set_playing (CLUTTER_MEDIA (texture), FALSE);
+
+  report = clutter_gst_video_texture_get_pacing_report
+    (CLUTTER_GST_VIDEO_TEXTURE (texture));
+  gst_structure_get_uint (report, "frames", &frames);
+  gst_structure_get_uint (report, "stutters", &stutters);
+  on_pacing_report (CLUTTER_GST_VIDEO_TEXTURE (texture), report, NULL);
+  gst_structure_free (report);
+
+  passed = frames > 0 && stutters <= opt_max_stutters * frames;
+  g_print ("%u frames, %u stutters: %s\n",
+           frames, stutters, passed ? "PASS" : "FAIL");
+
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
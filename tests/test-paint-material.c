@@ -0,0 +1,307 @@
+/*
+ * Clutter-GStreamer.
+ *
+ * GStreamer integration library for Clutter.
+ *
+ * test-paint-material.c - Measure the per-frame CPU cost of displaying
+ * frames with cluttersink, material handling included. Compare the output
+ * of two builds to see what a change of the paint path costs.
+ *
+ * Copyright (C) 2011 Intel Corporation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#include <clutter-gst/clutter-gst.h>
+
+/* a sink not showing its first frame after that many seconds failed */
+#define PREROLL_TIMEOUT 10
+
+static gint   opt_frames = 150;
+static gint   opt_runs   = 5;
+static gint   opt_width  = 640;
+static gint   opt_height = 480;
+static gchar *opt_format = "I420";
+
+static GOptionEntry options[] =
+{
+  { "frames",
+    'n', 0,
+    G_OPTION_ARG_INT,
+    &opt_frames,
+    "Number of frames pushed for each run (default is 150)",
+    NULL
+  },
+  { "runs",
+    'r', 0,
+    G_OPTION_ARG_INT,
+    &opt_runs,
+    "Number of measured runs, after a warm-up one (default is 5)",
+    NULL
+  },
+  { "width",
+    'W', 0,
+    G_OPTION_ARG_INT,
+    &opt_width,
+    "Width of the frames (default is 640)",
+    NULL
+  },
+  { "height",
+    'H', 0,
+    G_OPTION_ARG_INT,
+    &opt_height,
+    "Height of the frames (default is 480)",
+    NULL
+  },
+  { "format",
+    'f', 0,
+    G_OPTION_ARG_STRING,
+    &opt_format,
+    "YUV fourcc of the frames (default is I420)",
+    NULL
+  },
+
+  { NULL }
+};
+
+static gdouble
+get_cpu_time (void)
+{
+  struct rusage usage;
+
+  getrusage (RUSAGE_SELF, &usage);
+
+  return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+         (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+static guint
+get_uploaded (GstElement *sink)
+{
+  GstStructure *stats;
+  guint uploaded = 0;
+
+  stats = clutter_gst_video_sink_get_stats (CLUTTER_GST_VIDEO_SINK (sink));
+  gst_structure_get_uint (stats, "uploaded", &uploaded);
+  gst_structure_free (stats);
+
+  return uploaded;
+}
+
+static gboolean
+on_bus_message (GstBus     *bus,
+                GstMessage *message,
+                gpointer    user_data)
+{
+  gboolean *done = user_data;
+
+  switch (GST_MESSAGE_TYPE (message))
+    {
+    case GST_MESSAGE_ERROR:
+    case GST_MESSAGE_EOS:
+      *done = TRUE;
+      break;
+
+    default:
+      break;
+    }
+
+  return TRUE;
+}
+
+static gboolean
+on_tick (gpointer user_data)
+{
+  return TRUE;
+}
+
+/* Plays opt_frames frames in @texture, returns the CPU time spent per
+ * uploaded frame, in µs, or a negative value if nothing was uploaded.
+ *
+ * The frames come at 30 fps with the sink synchronizing on the clock and
+ * uploading right before painting, so that every frame is uploaded and
+ * painted once instead of the sink dropping the ones superseded in its
+ * mailbox, whose generation would be counted too */
+static gdouble
+run (ClutterActor *texture)
+{
+  GstElement *pipeline, *src, *filter, *sink;
+  GstCaps *caps;
+  GstBus *bus;
+  GTimer *timer;
+  guint watch_id, tick_id;
+  guint uploaded;
+  gboolean done = FALSE;
+  gdouble cpu = -1;
+
+  pipeline = gst_pipeline_new (NULL);
+  src = gst_element_factory_make ("videotestsrc", NULL);
+  filter = gst_element_factory_make ("capsfilter", NULL);
+  sink = clutter_gst_video_sink_new (CLUTTER_TEXTURE (texture));
+
+  caps = gst_caps_new_simple ("video/x-raw-yuv",
+                              "format", GST_TYPE_FOURCC,
+                              GST_STR_FOURCC (opt_format),
+                              "width", G_TYPE_INT, opt_width,
+                              "height", G_TYPE_INT, opt_height,
+                              "framerate", GST_TYPE_FRACTION, 30, 1,
+                              NULL);
+
+  g_object_set (src, "num-buffers", opt_frames + 1, NULL);
+  g_object_set (filter, "caps", caps, NULL);
+  g_object_set (sink,
+                "upload-on-paint", TRUE,
+                "qos", FALSE,
+                NULL);
+  gst_caps_unref (caps);
+
+  gst_bin_add_many (GST_BIN (pipeline), src, filter, sink, NULL);
+  gst_element_link_many (src, filter, sink, NULL);
+
+  bus = gst_pipeline_get_bus (GST_PIPELINE (pipeline));
+  watch_id = gst_bus_add_watch (bus, on_bus_message, &done);
+
+  /* wakes the main loop up, for the timeout */
+  tick_id = g_timeout_add (10, on_tick, NULL);
+
+  /* the first frame sets up the renderer and links its program, it is not
+   * measured. Prerolling only gets it to the sink, it is uploaded once the
+   * clutter thread paints */
+  gst_element_set_state (pipeline, GST_STATE_PAUSED);
+  if (gst_element_get_state (pipeline, NULL, NULL, GST_CLOCK_TIME_NONE) !=
+      GST_STATE_CHANGE_SUCCESS)
+    goto out;
+
+  timer = g_timer_new ();
+  while (get_uploaded (sink) == 0 && !done &&
+         g_timer_elapsed (timer, NULL) < PREROLL_TIMEOUT)
+    g_main_context_iteration (NULL, TRUE);
+  g_timer_destroy (timer);
+
+  if (done || get_uploaded (sink) == 0)
+    goto out;
+
+  uploaded = get_uploaded (sink);
+  cpu = get_cpu_time ();
+
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+  while (!done)
+    g_main_context_iteration (NULL, TRUE);
+
+  cpu = get_cpu_time () - cpu;
+  uploaded = get_uploaded (sink) - uploaded;
+
+  cpu = uploaded ? cpu * 1e6 / uploaded : -1;
+
+out:
+  g_source_remove (tick_id);
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  g_source_remove (watch_id);
+  gst_object_unref (bus);
+  gst_object_unref (pipeline);
+
+  return cpu;
+}
+
+static gint
+compare_doubles (gconstpointer a,
+                 gconstpointer b)
+{
+  gdouble da = *(const gdouble *) a, db = *(const gdouble *) b;
+
+  return da < db ? -1 : da > db;
+}
+
+int
+main (int argc, char *argv[])
+{
+  GError *error = NULL;
+  ClutterActor *stage, *texture;
+  gdouble *runs, total = 0;
+  gint i;
+
+  if (!g_thread_supported ())
+    g_thread_init (NULL);
+
+  clutter_gst_init_with_args (&argc,
+                              &argv,
+                              " - Measure the cost of the paint material",
+                              options,
+                              NULL,
+                              &error);
+  if (error)
+    {
+      g_print ("%s\n", error->message);
+      g_error_free (error);
+      return EXIT_FAILURE;
+    }
+
+  if (strlen (opt_format) != 4)
+    {
+      g_print ("%s is not a fourcc\n", opt_format);
+      return EXIT_FAILURE;
+    }
+
+  if (opt_runs < 1)
+    {
+      g_print ("At least one run is needed\n");
+      return EXIT_FAILURE;
+    }
+
+  stage = clutter_stage_get_default ();
+  clutter_actor_set_size (stage, opt_width, opt_height);
+
+  texture = g_object_new (CLUTTER_TYPE_TEXTURE,
+                          "disable-slicing", TRUE,
+                          NULL);
+  clutter_actor_set_size (texture, opt_width, opt_height);
+  clutter_container_add_actor (CLUTTER_CONTAINER (stage), texture);
+  clutter_actor_show_all (stage);
+
+  /* the first run warms the caches of the driver up */
+  if (run (texture) < 0)
+    {
+      g_print ("No frame could be displayed\n");
+      return EXIT_FAILURE;
+    }
+
+  runs = g_new (gdouble, opt_runs);
+  for (i = 0; i < opt_runs; i++)
+    {
+      runs[i] = run (texture);
+      if (runs[i] < 0)
+        {
+          g_print ("No frame could be displayed\n");
+          return EXIT_FAILURE;
+        }
+      total += runs[i];
+    }
+  qsort (runs, opt_runs, sizeof (gdouble), compare_doubles);
+
+  g_print ("%s %dx%d, %d runs of %d frames\n",
+           opt_format, opt_width, opt_height, opt_runs, opt_frames);
+  g_print ("  min:    %8.1f us of CPU per frame\n", runs[0]);
+  g_print ("  median: %8.1f us of CPU per frame\n", runs[opt_runs / 2]);
+  g_print ("  mean:   %8.1f us of CPU per frame\n", total / opt_runs);
+
+  g_free (runs);
+
+  return EXIT_SUCCESS;
+}
@@ -34,6 +34,7 @@
 static gint   opt_framerate = 30;
 static gint   opt_bpp       = 24;
 static gint   opt_depth     = 24;
+static gboolean opt_pbo    = FALSE;
 
 static GOptionEntry options[] =
 {
@@ -58,6 +59,13 @@ static GOptionEntry options[] =
     "depth (default is 24)",
     NULL
   },
+  { "pixel-buffers",
+    'p', 0,
+    G_OPTION_ARG_NONE,
+    &opt_pbo,
+    "Upload the frames through pixel buffers",
+    NULL
+  },
 
   { NULL }
 };
@@ -150,6 +158,7 @@ main (int argc, char *argv[])
   src = gst_element_factory_make ("videotestsrc", NULL);
   capsfilter = gst_element_factory_make ("capsfilter", NULL);
   sink = clutter_gst_video_sink_new (CLUTTER_TEXTURE (texture));
+  g_object_set (sink, "use-pixel-buffers", opt_pbo, NULL);
 
   /* make videotestsrc spit the format we want */
   caps = gst_caps_new_simple ("video/x-raw-rgb",
@@ -0,0 +1,246 @@
+/*
+ * Clutter-GStreamer.
+ *
+ * GStreamer integration library for Clutter.
+ *
+ * test-sink-stress.c - Push frames to a cluttersink from several threads
+ * while the Clutter thread consumes them, and check that no reference to
+ * the frames is leaked and that the last frame is always the one shown.
+ *
+ * Copyright (C) 2011 Intel Corporation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <gst/base/gstbasesink.h>
+#include <clutter-gst/clutter-gst.h>
+
+#define WIDTH  64
+#define HEIGHT 64
+#define FRAME_SIZE (WIDTH * HEIGHT * 4)
+
+static gint opt_threads = 8;
+static gint opt_frames  = 2000;
+
+static GOptionEntry options[] =
+{
+  { "threads",
+    't', 0,
+    G_OPTION_ARG_INT,
+    &opt_threads,
+    "Number of threads pushing frames (default is 8)",
+    NULL
+  },
+  { "frames",
+    'n', 0,
+    G_OPTION_ARG_INT,
+    &opt_frames,
+    "Number of frames pushed by each thread (default is 2000)",
+    NULL
+  },
+
+  { NULL }
+};
+
+static volatile gint n_pushed;
+static volatile gint n_freed;
+static volatile gint n_running;
+static gint n_uploaded;
+
+static void
+frame_free (gpointer data)
+{
+  g_atomic_int_inc (&n_freed);
+  g_free (data);
+}
+
+static GstBuffer *
+frame_new (GstCaps *caps,
+           guint8   value)
+{
+  GstBuffer *buffer;
+  guint8 *data;
+
+  data = g_malloc (FRAME_SIZE);
+  memset (data, value, FRAME_SIZE);
+
+  buffer = gst_buffer_new ();
+  GST_BUFFER_DATA (buffer) = data;
+  GST_BUFFER_MALLOCDATA (buffer) = data;
+  GST_BUFFER_FREE_FUNC (buffer) = frame_free;
+  GST_BUFFER_SIZE (buffer) = FRAME_SIZE;
+  gst_buffer_set_caps (buffer, caps);
+
+  g_atomic_int_inc (&n_pushed);
+
+  return buffer;
+}
+
+/* what a streaming thread does, calling the render function of the sink
+ * directly lets several threads hit the hand-off to the Clutter thread at
+ * the same time */
+static GstFlowReturn
+push_frame (GstElement *sink,
+            GstBuffer  *buffer)
+{
+  GstBaseSinkClass *klass = GST_BASE_SINK_GET_CLASS (sink);
+  GstFlowReturn ret;
+
+  ret = klass->render (GST_BASE_SINK (sink), buffer);
+  gst_buffer_unref (buffer);
+
+  return ret;
+}
+
+static gpointer
+pusher_thread (gpointer data)
+{
+  GstElement *sink = GST_ELEMENT (data);
+  GstCaps *caps;
+  int i;
+
+  caps = gst_pad_get_negotiated_caps (GST_BASE_SINK_PAD (sink));
+
+  for (i = 0; i < opt_frames; i++)
+    {
+      /* never 0xff, that's the value of the last frame */
+      if (push_frame (sink, frame_new (caps, i % 0xff)) != GST_FLOW_OK)
+        g_error ("the sink refused a frame");
+    }
+
+  gst_caps_unref (caps);
+  g_atomic_int_add (&n_running, -1);
+
+  return NULL;
+}
+
+static void
+on_new_frame (ClutterTexture *texture,
+              gpointer        user_data)
+{
+  n_uploaded++;
+}
+
+static void
+iterate_main_loop (void)
+{
+  while (g_main_context_pending (NULL))
+    g_main_context_iteration (NULL, FALSE);
+}
+
+int
+main (int argc, char *argv[])
+{
+  GError *error = NULL;
+  ClutterActor *texture;
+  GstElement *sink;
+  GstPad *pad;
+  GstCaps *caps;
+  GThread **threads;
+  CoglHandle tex;
+  guint8 *pixels;
+  int i;
+
+  if (!g_thread_supported ())
+    g_thread_init (NULL);
+
+  clutter_gst_init_with_args (&argc,
+                              &argv,
+                              " - Stress the frame hand-off of the sink",
+                              options,
+                              NULL,
+                              &error);
+
+  if (error)
+    {
+      g_print ("%s\n", error->message);
+      g_error_free (error);
+      return EXIT_FAILURE;
+    }
+
+  texture = g_object_new (CLUTTER_TYPE_TEXTURE,
+                          "disable-slicing", TRUE,
+                          NULL);
+  g_object_ref_sink (texture);
+  g_signal_connect (texture, "pixbuf-change",
+                    G_CALLBACK (on_new_frame), NULL);
+
+  sink = clutter_gst_video_sink_new (CLUTTER_TEXTURE (texture));
+  gst_object_ref_sink (sink);
+
+  caps = gst_caps_new_simple ("video/x-raw-rgb",
+                              "bpp", G_TYPE_INT, 32,
+                              "depth", G_TYPE_INT, 32,
+                              "endianness", G_TYPE_INT, G_BIG_ENDIAN,
+                              "red_mask", G_TYPE_INT, 0xff000000,
+                              "green_mask", G_TYPE_INT, 0x00ff0000,
+                              "blue_mask", G_TYPE_INT, 0x0000ff00,
+                              "alpha_mask", G_TYPE_INT, 0x000000ff,
+                              "width", G_TYPE_INT, WIDTH,
+                              "height", G_TYPE_INT, HEIGHT,
+                              "framerate", GST_TYPE_FRACTION, 30, 1,
+                              NULL);
+
+  gst_element_set_state (sink, GST_STATE_PAUSED);
+
+  pad = gst_element_get_static_pad (sink, "sink");
+  if (!gst_pad_set_caps (pad, caps))
+    g_error ("the sink refused %" GST_PTR_FORMAT, caps);
+  gst_object_unref (pad);
+
+  /* hammer the sink from several threads while consuming the frames */
+  n_running = opt_threads;
+  threads = g_new (GThread *, opt_threads);
+  for (i = 0; i < opt_threads; i++)
+    threads[i] = g_thread_create (pusher_thread, sink, TRUE, NULL);
+
+  while (g_atomic_int_get (&n_running) > 0)
+    iterate_main_loop ();
+
+  for (i = 0; i < opt_threads; i++)
+    g_thread_join (threads[i]);
+  g_free (threads);
+
+  /* the last frame pushed must be the one that ends up in the texture */
+  push_frame (sink, frame_new (caps, 0xff));
+  iterate_main_loop ();
+
+  tex = clutter_texture_get_cogl_texture (CLUTTER_TEXTURE (texture));
+  pixels = g_malloc (FRAME_SIZE);
+  cogl_texture_get_data (tex, COGL_PIXEL_FORMAT_RGBA_8888, WIDTH * 4, pixels);
+  for (i = 0; i < FRAME_SIZE; i++)
+    if (pixels[i] != 0xff)
+      g_error ("the last frame was lost");
+  g_free (pixels);
+
+  /* every frame has either been uploaded or superseded by a newer one */
+  if (g_atomic_int_get (&n_freed) != g_atomic_int_get (&n_pushed))
+    g_error ("%d frames pushed but only %d freed",
+             g_atomic_int_get (&n_pushed), g_atomic_int_get (&n_freed));
+
+  g_print ("%d frames pushed from %d threads, %d uploaded\n",
+           g_atomic_int_get (&n_pushed), opt_threads, n_uploaded);
+
+  gst_element_set_state (sink, GST_STATE_NULL);
+  gst_object_unref (sink);
+  gst_caps_unref (caps);
+  g_object_unref (texture);
+
+  return EXIT_SUCCESS;
+}
@@ -33,6 +33,7 @@
 
 static gint   opt_framerate = 30;
 static gchar *opt_fourcc    = "I420";
+static gboolean opt_pbo     = FALSE;
 
 static GOptionEntry options[] =
 {
@@ -48,6 +49,12 @@ static GOptionEntry options[] =
     &opt_fourcc,
     "Fourcc of the wanted YUV format",
     NULL },
+  { "pixel-buffers",
+    'p', 0,
+    G_OPTION_ARG_NONE,
+    &opt_pbo,
+    "Upload the frames through pixel buffers",
+    NULL },
 
   { NULL }
 };
@@ -148,6 +155,7 @@ main (int argc, char *argv[])
   src = gst_element_factory_make ("videotestsrc", NULL);
   capsfilter = gst_element_factory_make ("capsfilter", NULL);
   sink = clutter_gst_video_sink_new (CLUTTER_TEXTURE (texture));
+  g_object_set (sink, "use-pixel-buffers", opt_pbo, NULL);
 
   /* make videotestsrc spit the format we want */
   caps = gst_caps_new_simple ("video/x-raw-yuv",